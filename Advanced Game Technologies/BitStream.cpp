@@ -0,0 +1,111 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Reading and writing values a few bits at a time into a fixed byte buffer.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "BitStream.h"
+#include <cstring>
+using namespace NCL;
+using namespace CSC8503;
+
+int NCL::CSC8503::BitsRequired(unsigned int range)
+{
+	int bits = 0;
+	while (range > 0)
+	{
+		bits++;
+		range >>= 1;
+	}
+	return bits;
+}
+
+BitWriter::BitWriter(char* buffer, int capacityBytes)
+{
+	this->buffer = (unsigned char*)buffer;
+	capacityBits = capacityBytes * 8;
+	bitPosition = 0;
+	overflowed = false;
+	// Bits get OR'd in, so everything has to start from zero.
+	memset(buffer, 0, capacityBytes);
+}
+
+void BitWriter::WriteBits(unsigned int value, int bitCount)
+{
+	if (bitPosition + bitCount > capacityBits)
+	{
+		overflowed = true;
+		return;
+	}
+
+	// Fill whatever's left of the current byte, then move onto the next, lowest bits first.
+	while (bitCount > 0)
+	{
+		int byteIndex = bitPosition >> 3;
+		int bitOffset = bitPosition & 7;
+		int bitsThisByte = 8 - bitOffset;
+		if (bitsThisByte > bitCount)
+			bitsThisByte = bitCount;
+
+		unsigned int mask = (1u << bitsThisByte) - 1;
+		buffer[byteIndex] |= (unsigned char)((value & mask) << bitOffset);
+
+		value >>= bitsThisByte;
+		bitCount -= bitsThisByte;
+		bitPosition += bitsThisByte;
+	}
+}
+
+void BitWriter::WriteInt(int value, int min, int max)
+{
+	if (value < min)
+		value = min;
+	else if (value > max)
+		value = max;
+	WriteBits((unsigned int)(value - min), BitsRequired((unsigned int)(max - min)));
+}
+
+BitReader::BitReader(const char* buffer, int sizeBytes)
+{
+	this->buffer = (const unsigned char*)buffer;
+	sizeBits = sizeBytes * 8;
+	bitPosition = 0;
+	overflowed = false;
+}
+
+unsigned int BitReader::ReadBits(int bitCount)
+{
+	if (bitPosition + bitCount > sizeBits)
+	{
+		overflowed = true;
+		return 0;
+	}
+
+	unsigned int value = 0;
+	int shift = 0;
+	while (bitCount > 0)
+	{
+		int byteIndex = bitPosition >> 3;
+		int bitOffset = bitPosition & 7;
+		int bitsThisByte = 8 - bitOffset;
+		if (bitsThisByte > bitCount)
+			bitsThisByte = bitCount;
+
+		unsigned int mask = (1u << bitsThisByte) - 1;
+		value |= ((buffer[byteIndex] >> bitOffset) & mask) << shift;
+
+		shift += bitsThisByte;
+		bitCount -= bitsThisByte;
+		bitPosition += bitsThisByte;
+	}
+	return value;
+}
+
+int BitReader::ReadInt(int min, int max)
+{
+	return min + (int)ReadBits(BitsRequired((unsigned int)(max - min)));
+}
@@ -0,0 +1,62 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Reading and writing values a few bits at a time into a fixed byte buffer, so packets only spend as many bits on a value as its range needs.
+Writing past the end of the buffer doesn't write anything, it just marks the stream as overflowed- check before sending.
+Reading past the end gives back zeroes and marks the stream the same way.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+
+namespace NCL {
+	namespace CSC8503 {
+		class BitWriter
+		{
+		public:
+			BitWriter(char* buffer, int capacityBytes);
+			~BitWriter() {}
+
+			// Lowest bitCount bits of value, up to 32.
+			void WriteBits(unsigned int value, int bitCount);
+			void WriteBool(bool value) { WriteBits(value ? 1 : 0, 1); }
+			// Value clamped into [min, max] and stored in just enough bits for that range.
+			void WriteInt(int value, int min, int max);
+
+			int GetBitsWritten() const { return bitPosition; }
+			int GetBytesWritten() const { return (bitPosition + 7) / 8; }
+			bool HasOverflowed() const { return overflowed; }
+
+		protected:
+			unsigned char* buffer;
+			int capacityBits;
+			int bitPosition;
+			bool overflowed;
+		};
+
+		class BitReader
+		{
+		public:
+			BitReader(const char* buffer, int sizeBytes);
+			~BitReader() {}
+
+			unsigned int ReadBits(int bitCount);
+			bool ReadBool() { return ReadBits(1) != 0; }
+			int ReadInt(int min, int max);
+
+			bool HasOverflowed() const { return overflowed; }
+
+		protected:
+			const unsigned char* buffer;
+			int sizeBits;
+			int bitPosition;
+			bool overflowed;
+		};
+
+		// How many bits it takes to store every value from 0 to range.
+		int BitsRequired(unsigned int range);
+	}
+}
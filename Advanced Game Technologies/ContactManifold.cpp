@@ -0,0 +1,108 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A persistent set of contact points between one pair of objects.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "ContactManifold.h"
+#include "GameObject.h"
+using namespace NCL;
+using namespace CSC8503;
+
+namespace {
+	// How close a new contact has to be to an old one (in object space) to be counted as the same point.
+	const float MATCH_DISTANCE = 0.1f;
+	// How far apart, or how far slid sideways, a point can get before it's thrown away.
+	const float BREAKING_DISTANCE = 0.05f;
+}
+
+void ContactManifold::AddContact(const GameObject& objA, const GameObject& objB, const CollisionDetection::ContactPoint& p)
+{
+	Quaternion invOrientationA = objA.GetConstTransform().GetWorldOrientation().Conjugate();
+	Quaternion invOrientationB = objB.GetConstTransform().GetWorldOrientation().Conjugate();
+
+	// Contact points come in relative to each object's position but in world orientation- store them in object space instead.
+	Vector3 localA = invOrientationA * p.localA;
+	Vector3 localB = invOrientationB * p.localB;
+	Vector3 normal = p.normal;
+
+	// The narrowphase can hand the pair back the other way round depending on volume types.
+	if (&objA != a)
+	{
+		std::swap(localA, localB);
+		normal = -normal;
+	}
+
+	int index = FindMatchingPoint(localA);
+
+	if (index < 0)
+	{
+		if (numPoints < MAX_POINTS)
+		{
+			index = numPoints++;
+		}
+		else
+		{
+			// Full, so replace the shallowest point- the deepest ones matter most for keeping things apart.
+			index = 0;
+			for (int i = 1; i < numPoints; ++i)
+			{
+				if (points[i].penetration < points[index].penetration)
+					index = i;
+			}
+		}
+
+		points[index].normalImpulse = 0.0f;
+		points[index].tangentImpulse[0] = 0.0f;
+		points[index].tangentImpulse[1] = 0.0f;
+	}
+
+	// Matched points keep their accumulated impulses, that's the whole point of warm starting.
+	points[index].localA = localA;
+	points[index].localB = localB;
+	points[index].normal = normal;
+	points[index].penetration = p.penetration;
+}
+
+void ContactManifold::Refresh()
+{
+	const Transform& transformA = a->GetConstTransform();
+	const Transform& transformB = b->GetConstTransform();
+
+	for (int i = numPoints - 1; i >= 0; --i)
+	{
+		ManifoldPoint& point = points[i];
+
+		Vector3 worldA = transformA.GetWorldPosition() + transformA.GetWorldOrientation() * point.localA;
+		Vector3 worldB = transformB.GetWorldPosition() + transformB.GetWorldOrientation() * point.localB;
+
+		// Point A sits inside B along the normal while they're overlapping.
+		Vector3 difference = worldA - worldB;
+		point.penetration = Vector3::Dot(difference, point.normal);
+
+		Vector3 tangentialDrift = difference - point.normal * point.penetration;
+
+		if (point.penetration < -BREAKING_DISTANCE || tangentialDrift.LengthSquared() > BREAKING_DISTANCE * BREAKING_DISTANCE)
+			RemovePoint(i);
+	}
+}
+
+int ContactManifold::FindMatchingPoint(const Vector3& localA) const
+{
+	for (int i = 0; i < numPoints; ++i)
+	{
+		if ((points[i].localA - localA).LengthSquared() < MATCH_DISTANCE * MATCH_DISTANCE)
+			return i;
+	}
+	return -1;
+}
+
+void ContactManifold::RemovePoint(int index)
+{
+	points[index] = points[numPoints - 1];
+	numPoints--;
+}
@@ -0,0 +1,71 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A persistent set of contact points between one pair of objects.
+Points are kept across frames along with the impulses last applied at them, so the contact solver can warm start.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "CollisionDetection.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		class GameObject;
+
+		struct ManifoldPoint
+		{
+			// Contact positions in each object's own space, so they follow the objects as they move and turn.
+			Vector3 localA;
+			Vector3 localB;
+			Vector3 normal;
+			float penetration;
+
+			// Impulses accumulated over the solver iterations- carried into the next frame for warm starting.
+			float normalImpulse;
+			float tangentImpulse[2];
+
+			// Worked out once per step before iterating.
+			Vector3 relativeA;
+			Vector3 relativeB;
+			Vector3 tangents[2];
+			float normalMass;
+			float tangentMass[2];
+			float targetVelocity;
+		};
+
+		class ContactManifold
+		{
+		public:
+			static const int MAX_POINTS = 4;
+
+			ContactManifold() : a(nullptr), b(nullptr), numPoints(0) {}
+			ContactManifold(GameObject* a, GameObject* b) : a(a), b(b), numPoints(0) {}
+
+			GameObject* GetObjectA() const { return a; }
+			GameObject* GetObjectB() const { return b; }
+
+			int GetNumPoints() const { return numPoints; }
+			ManifoldPoint& GetPoint(int i) { return points[i]; }
+
+			// Add a newly detected contact, merging it into an existing point if it's close enough to be the same one.
+			void AddContact(const GameObject& objA, const GameObject& objB, const CollisionDetection::ContactPoint& p);
+
+			// Recalculate penetration from where the objects are now, dropping any points that have come apart or slid away.
+			void Refresh();
+
+		protected:
+			int FindMatchingPoint(const Vector3& localA) const;
+			void RemovePoint(int index);
+
+			GameObject* a;
+			GameObject* b;
+
+			ManifoldPoint points[MAX_POINTS];
+			int numPoints;
+		};
+	}
+}
@@ -22,6 +22,17 @@ A full instance of a goose game.
 #include "../CSC8503Common/OrientationConstraint.h"
 #include "../CSC8503Common/UpwardsConstraint.h"
 #include "../CSC8503Common/NavigationGrid.h"
+#include "PathRequestService.h"
+#include "EnemySystem.h"
+#include "../CSC8503Common/FlowField.h"
+#include "WorldSnapshot.h"
+#include "NetworkScheduler.h"
+#include "GoosePrediction.h"
+#include "HighScoreTable.h"
+#include "SessionManager.h"
+#include "NetworkThread.h"
+#include "PacketRecorder.h"
+#include "InterestManager.h"
 #include "../../Common/Assets.h"
 #include <sstream>
 #include <fstream>
@@ -30,6 +41,38 @@ A full instance of a goose game.
 using namespace NCL;
 using namespace CSC8503;
 
+// How many enemies it takes before sharing one flow field beats each of them planning on their own.
+const int FLOW_FIELD_MIN_CHASERS = 6;
+// World snapshots per second from the server- clients only ever need to see the world move, the physics itself stays on the server.
+const float SNAPSHOT_SEND_RATE = 20.0f;
+// Everything else goes out batched at this rate, however fast either end renders.
+const float NETWORK_TICK_RATE = 30.0f;
+// More than there are islands in the multiplayer level- anyone past the islands gets to watch.
+const int MAX_CLIENTS = 8;
+// Clients send something every network tick while they're connected, so this long without anything means they've gone.
+const float SESSION_TIMEOUT = 5.0f;
+// How far from their goose clients hear about things moving. Past this they're left where the client last saw them.
+const float RELEVANCE_RADIUS = 60.0f;
+// How far in front of a goose an item can be picked up from.
+const float PICKUP_RANGE = 3.0f;
+// The gate swings, so the cells either side of where it's hung are checked against the physics world every so often.
+const Vector3 GATE_POSITION = Vector3(20, 0, 80);
+const int GATE_CELL_RADIUS = 1;
+const float GATE_CHECK_INTERVAL = 0.25f;
+// Above the floor and below the tops of fences and the gate.
+const float GATE_PROBE_HEIGHT = 1.0f;
+
+// Messages on the same channel replace each other within a tick- only the newest is worth sending.
+enum NetworkChannel
+{
+	GOOSE_INPUT_CHANNEL,
+	SNAPSHOT_CHANNEL,
+	SNAPSHOT_ACK_CHANNEL,
+	HIGH_SCORE_CHANNEL,
+	HIGH_SCORE_REQUEST_CHANNEL,
+	CONNECTION_CHANNEL,
+};
+
 CourseworkGame::CourseworkGame() {
 	world = new GameWorld();
 	renderer = new GameTechRenderer(*world);
@@ -38,6 +81,10 @@ CourseworkGame::CourseworkGame() {
 	forceMagnitude = 10.0f;
 	useGravity = true;
 	physics->UseGravity(useGravity);
+	// Thrown items and a goose at full force can cross a whole fence or hedge in one step.
+	physics->UseContinuousCollision(true);
+	// Scenery only ever needs to be tested against things moving around it.
+	physics->SetLayerInteraction(GameObject::SETTING, GameObject::SETTING, false);
 	inSelectionMode = false;
 	camDistanceFromPlayer = 20;
 
@@ -52,6 +99,30 @@ CourseworkGame::CourseworkGame() {
 
 	heldItemIDCounter = 0;
 
+	levelGrid = nullptr;
+	chaseField = nullptr;
+	gateCheckTimer = 0.0f;
+	levelHierarchy = nullptr;
+	pathService = new PathRequestService();
+	// The keeper's only ever run by the server, so it gets a system of its own.
+	enemyAI = new EnemySystem(pathService);
+	keeperAI = new EnemySystem(pathService);
+	enemyAI->SetMinFlowFieldChasers(FLOW_FIELD_MIN_CHASERS);
+	keeperAI->SetMinFlowFieldChasers(FLOW_FIELD_MIN_CHASERS);
+
+	snapshotSender = new SnapshotSender(SNAPSHOT_SEND_RATE);
+	snapshotReceiver = new SnapshotReceiver(SNAPSHOT_SEND_RATE);
+	goosePrediction = new GoosePrediction();
+	interestManager = new InterestManager(RELEVANCE_RADIUS);
+	clientHeldItemID = -1;
+	clientGooseIndex = -1;
+	networkScheduler = nullptr;
+	packetDispatcher = nullptr;
+	sessions = nullptr;
+	networkThread = nullptr;
+	packetRecorder = nullptr;
+
+	highScoreTable = new HighScoreTable();
 	showHighScores = false;
 	newPlayerJoined = false;
 
@@ -87,6 +158,16 @@ void CourseworkGame::UpdateGame(float dt) {
 
 	else if (currentMenuState == StateType::GAME)
 	{
+		// Everything the network thread's picked up since last tick, handled before anything else so input's applied this frame.
+		if (gameType == CLIENT)
+			networkThread->Drain(networkScheduler);
+		else if (gameType == SERVER)
+		{
+			// Through the recorder, so a recording has every packet the sessions see, in the tick they saw it.
+			packetRecorder->BeginTick(dt);
+			networkThread->Drain(packetRecorder);
+		}
+
 		// Timer updating- single player does this with no limits. 
 		// Server will only start the timer once its signalled as having a client connected..
 		// Clients don't update the timer at all though will check if its over.
@@ -100,12 +181,9 @@ void CourseworkGame::UpdateGame(float dt) {
 				if (timeRemaining <= 0)
 				{
 					timeUp = true;
-				}
-
-				if (gameType == SERVER)
-				{
-					// send a packet with the new time to display
-					server->SendGlobalPacket(IntPacket(timeRemaining));
+					// The only time the table's written back- it's never read from file again while the server's running.
+					if (gameType == SERVER)
+						ServerSubmitHighScores();
 				}
 			}
 		}
@@ -133,9 +211,14 @@ void CourseworkGame::UpdateGame(float dt) {
 
 		SelectObject();
 
-		if (gameType != SERVER)
+		if (gameType == SERVER)
 		{
-			MoveGoose();
+			MoveGeeseForServer(dt);
+		}
+		// A client can't move anything until the server's told it which goose is its own.
+		else if (gameType == SINGLE || clientGooseIndex >= 0)
+		{
+			MoveGoose(dt);
 			if (Window::GetMouse()->ButtonPressed(NCL::MouseButtons::RIGHT))
 			{
 				// Single player performs item pickup check as normal.
@@ -143,16 +226,9 @@ void CourseworkGame::UpdateGame(float dt) {
 				{
 					if (!playerGoose->IsHoldingItem())
 					{
-						// Send a ray out from the front of the player to try and pick up a held item in front of them.
-						Ray ray = Ray(playerGoose->GetTransform().GetWorldPosition(), playerGoose->GetTransform().GetWorldOrientation() * Vector3(0, 0, 1));
-						RayCollision closestCollision;
-
-						if (world->Raycast(ray, closestCollision, playerGoose, true))
-						{
-							HeldItem* item = (HeldItem*)closestCollision.node;
-							if (closestCollision.rayDistance < 3.0f && closestCollision.rayDistance > 0)
-								playerGoose->PickUpItem(item);
-						}
+						// Pick up a held item in front of the player, if there is one.
+						if (HeldItem* item = FindItemInFront(playerGoose))
+							playerGoose->PickUpItem(item);
 					}
 					else
 					{
@@ -160,45 +236,57 @@ void CourseworkGame::UpdateGame(float dt) {
 						playerGoose->DropHeldItem();
 					}
 				}
-				// Client player needs to pass on the fact that item pickup button was pressed to the server.
+				// Client player needs to pass on the fact that item pickup button was pressed to the server- every press counts, so nothing gets merged.
 				else
 				{
-					client->SendPacket(ClientPlayerInputPacket());
+					networkScheduler->Send(ClientPlayerInputPacket(), NetworkScheduler::NO_CHANNEL, NetworkScheduler::RELIABLE);
 				}
 			}
 		}
-		else
+
+		// Enemies are run by the server and come through in its snapshots, so clients leave them alone.
+		if (gameType != CLIENT)
 		{
-			// Since the server only updates goose movement when player input comes through, any held item needs to be updated seperately still to prevent gravity stealing it.
-			playerGoose->UpdateHeldItem();
-		}
+			// Before any paths are started this frame, so none are planned through a gate that's just shut.
+			UpdateGateNavigation(dt);
+			UpdateEnemyTargets();
+			// Collect any paths finished since last frame, and start off this frame's share of new ones.
+			pathService->Update();
 
-		for (int i = 0; i < enemies.size(); ++i)
-			enemies[i]->UpdateEnemyMovement(dt);
+			enemyAI->Update(dt);
+		}
 
 		world->UpdateWorld(dt);
 		renderer->Update(dt);
+		// Physics runs its own fixed steps internally, so the raw frame time is fine to hand straight over.
 		physics->Update(dt);
 
 		if (gameType == CLIENT)
 		{
-			// Signalling to the server that a new player's joined.
+			// Signalling to the server that a new player's joined. It's reliable, so only needs saying the once.
 			if (newPlayerJoined)
 			{
-				client->SendPacket(NewPlayerPacket(0));
+				networkScheduler->Send(NewPlayerPacket(0), CONNECTION_CHANNEL, NetworkScheduler::RELIABLE);
+				newPlayerJoined = false;
 			}
 
 			renderer->DrawString("CLIENT", Vector2(1000, 600), Vector4(0, 0, 1, 1));
 
-			client->UpdateClient();
+			// Everything the server runs is drawn a little behind, blended between snapshots.
+			snapshotReceiver->Update(dt);
+			// That includes whatever our goose is holding- put it back on our own goose, which is drawn where we've predicted it.
+			if (clientGooseIndex >= 0)
+				playerGoose->UpdateHeldItem();
 			
-			// Show or hide the high score menu- opening the menu requests high score information from the server.
+			// Show or hide the high score menu- opening the menu asks the server for anything that's changed since the scores we've got.
 			if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::H))
 			{
-				client->SendPacket(RequestPacket());
+				networkScheduler->Send(HighScoreRequestPacket(highScoreTable->GetTableID(), highScoreTable->GetVersion()), HIGH_SCORE_REQUEST_CHANNEL, NetworkScheduler::RELIABLE);
 				showHighScores = !showHighScores;
 			}
 
+			networkScheduler->Update(dt);
+
 			if (showHighScores)
 				DisplayHighScoreTable();
 			
@@ -207,14 +295,29 @@ void CourseworkGame::UpdateGame(float dt) {
 		else if (gameType == SERVER)
 		{
 			renderer->DrawString("SERVER", Vector2(1000, 600), Vector4(0, 0, 1, 1));
-			// Server moves the player and sends a packet to the client with its new position. 
-			keeper->UpdateEnemyMovement(dt);
-			server->SendGlobalPacket(PositionPacket(keeper->GetTransform().GetWorldPosition()));
 
-			server->UpdateServer();
+			// Record everything coming in from here on, for playing back through the load test's headless server.
+			// Only before anyone's joined- a recording started part way through has none of the clients' reliable channel state,
+			// so played back, every reliable message would be waiting on sequence numbers from before it started.
+			bool canRecord = sessions->GetCount() == 0;
+			if (Window::GetKeyboard()->KeyPressed(KeyboardKeys::F5))
+			{
+				if (packetRecorder->IsRecording())
+					packetRecorder->Stop();
+				else if (canRecord)
+					packetRecorder->Start(Assets::DATADIR + "ServerRecording.rec");
+			}
+			if (packetRecorder->IsRecording())
+				Debug::Print("Recording (F5 to stop)", Vector2(10, 60));
+			else
+				Debug::Print(canRecord ? "(F5) Record" : "Recording has to start before anyone joins", Vector2(10, 60));
+
+			keeperAI->Update(dt);
 
-			if (sendHighScores)
-				SendHighScoreTable();
+			ServerSendSnapshots(dt);
+
+			// Every client's batch goes out on the same tick, just to that client.
+			sessions->Update(dt);
 		}
 			
 
@@ -266,7 +369,7 @@ void CourseworkGame::ResetGame()
 	selectionObject = nullptr;
 }
 
-void CourseworkGame::MoveGoose()
+void CourseworkGame::MoveGoose(float dt)
 {
 
 	// Get the forward vector for where the goose currently faces.
@@ -312,23 +415,41 @@ void CourseworkGame::MoveGoose()
 	float torqueDir = Vector3::Dot(gooseFwd, rotationTargetDir);
 	float direction = (torqueDir < 0 ? -1 : 1);
 
+	Vector3 force = Vector3(0, 0, 0);
+	Vector3 torque = Vector3(0, 0, 0);
+
 	// Only move if we have somewhere to go!
 	if (targetDir != Vector3(0,0,0))
 	{
 		// Wakey wakey you need to move!
 		playerGoose->SetSleeping(false);
 
-		// Actually move by applying force.
-		playerGoose->GetPhysicsObject()->AddForce(movementTargetDir * forceMagnitude);
+		force = movementTargetDir * forceMagnitude;
 
 		// Subtract the torque result between where the goose is and where he wants to face from the amount of torque to apply. 
 		// This will gradually scale the torque down towards 0 as the target is reached (with a bit left either side for waddle...)
 		float yTorque = 5 - Vector3::Dot(gooseFwd.Normalised(), targetDir.Normalised());
-		playerGoose->GetPhysicsObject()->AddTorque(Vector3(0, yTorque, 0) * direction);
+		torque = Vector3(0, yTorque, 0) * direction;
+	}
 
-		// Client needs to tell the server where it's trying to go so the server can maintain a consistent world state.
-		if (gameType == CLIENT)
-			client->SendPacket(PositionPacket(movementTargetDir * forceMagnitude, yTorque, direction));
+	// Rounded off the same as it's sent to the server, so the goose there gets exactly the push this one does.
+	GooseInput input = goosePrediction->QuantiseInput(dt, force, torque);
+	if (targetDir != Vector3(0, 0, 0))
+	{
+		// Actually move by applying force.
+		playerGoose->GetPhysicsObject()->AddForce(DequantiseForce(input));
+		playerGoose->GetPhysicsObject()->AddTorque(DequantiseTorque(input));
+	}
+
+	// Client moves straight away, and tells the server where it's trying to go so the server can maintain a consistent world state.
+	// Standing still is an input too, so the server's acknowledgements keep up while the goose slides to a stop.
+	// Each packet carries every input the server hasn't acknowledged, so only the newest each tick needs to go- nothing's lost by it replacing the last.
+	if (gameType == CLIENT)
+	{
+		goosePrediction->RecordInput(playerGoose->GetTransform().GetWorldPosition(), playerGoose->GetTransform().GetLocalOrientation(), input);
+		GooseInputPacket inputs;
+		goosePrediction->WriteInputs(inputs);
+		networkScheduler->Send(inputs, GOOSE_INPUT_CHANNEL, NetworkScheduler::UNRELIABLE);
 	}
 
 	// Held items need their own updating for how they're attached.
@@ -347,9 +468,21 @@ void CourseworkGame::MoveGoose()
 }
 
 void CourseworkGame::InitWorld() {
+	// Enemies are about to be erased along with the rest of the world.
+	enemyAI->Clear();
+	keeperAI->Clear();
+	snapshotSender->Clear();
+	snapshotReceiver->Clear();
+	goosePrediction->Clear();
+	interestManager->Clear();
 	world->ClearAndErase();
 	physics->Clear();
 	enemies.clear();
+	geese.clear();
+	// Starting the IDs from nothing again keeps each one the same as its index, and the same on the server and every client.
+	heldItemsInWorld.clear();
+	heldItemIDCounter = 0;
+	playerGoose = nullptr;
 
 	if (currentMenuState == MAIN)
 	{
@@ -359,24 +492,53 @@ void CourseworkGame::InitWorld() {
 	}
 	else if (currentMenuState == GAME)
 	{
-		if (gameType == SINGLE)
-			LoadWorldFromFile("GooseLevel.txt");
-		else
-			LoadWorldFromFile("MultiplayerGooseLevel.txt"); 
+		std::string levelFile = (gameType == SINGLE) ? "GooseLevel.txt" : "MultiplayerGooseLevel.txt";
+		LoadWorldFromFile(levelFile);
+		LoadNavigationGrid(levelFile);
 
+		enemyAI->SetLevel(levelGrid, chaseField);
 		for (int i = 0; i < enemies.size(); ++i)
-		{
-			enemies[i]->SetPlayer(playerGoose);
-			enemies[i]->SetupStateMachine();
-		}
+			enemyAI->AddEnemy(enemies[i]);
 
 		// Keeper information needs to be set up seperately to the rest of the enemies as server/client dependant.
 		if (keeper)
 		{
-			keeper->SetPlayer(playerGoose);
-			keeper->SetupStateMachine();
+			keeperAI->SetLevel(levelGrid, chaseField);
+			keeperAI->AddEnemy(keeper);
+		}
+
+		if (gameType != SINGLE)
+			AddNetworkedObjects();
+	}
+}
+
+// Both ends build the world from the same level file, so adding objects in the same order here gives them the same index in every snapshot.
+void CourseworkGame::AddNetworkedObjects()
+{
+	std::vector<GameObject*> networked;
+	for (GooseObject* goose : geese)
+		networked.emplace_back(goose);
+	if (keeper)
+		networked.emplace_back(keeper);
+	for (EnemyObject* enemy : enemies)
+		networked.emplace_back(enemy);
+	for (HeldItem* item : heldItemsInWorld)
+		networked.emplace_back(item);
+
+	for (GameObject* object : networked)
+	{
+		if (gameType == SERVER)
+		{
+			snapshotSender->AddObject(object);
+			interestManager->AddObject(object);
 		}
+		else
+			snapshotReceiver->AddObject(object);
 	}
+
+	// The client drives its own goose, so only needs everything else moving to match the server.
+	if (gameType == CLIENT && clientGooseIndex >= 0)
+		ClientAssignGoose(clientGooseIndex);
 }
 
 /*
@@ -437,11 +599,17 @@ void CourseworkGame::LoadWorldFromFile(std::string file)
 						AddCubeToWorld(pos, cubeDims / 2, 0, Vector4(0.827, 0.827, 0.827, 1));
 						break;
 					case 'I':
-						// Each island comes with a player goose- this could be used for setting up multiplayer later on.
+					{
+						// Each island comes with a player goose- in multiplayer each client gets one of them, in the order they're in the file.
 						spawnIsland = AddIslandToWorld(Vector3(pos.x, -18, pos.z), 20);
-						playerGoose = AddGooseToWorld(spawnIsland->GetTransform().GetWorldPosition() + Vector3(0, 11, 0));
-						spawnIsland->SetStartingPlayer(playerGoose);
+						GooseObject* goose = AddGooseToWorld(spawnIsland->GetTransform().GetWorldPosition() + Vector3(0, 11, 0));
+						spawnIsland->SetStartingPlayer(goose);
+						geese.emplace_back(goose);
+						// The first is the one single player uses and the server's camera follows.
+						if (!playerGoose)
+							playerGoose = goose;
 						break;
+					}
 					case '~':
 						AddWaterToWorld(pos, Vector3(cubeDims.x , 1, cubeDims.z)); break;
 					case 'f':
@@ -483,13 +651,96 @@ void CourseworkGame::LoadWorldFromFile(std::string file)
 		infile.close();
 		
 		// Seperate functions for now as they span multiple nodes.
-		AddGateToWorld(Vector3(20, 0, 80));
+		AddGateToWorld(GATE_POSITION);
 		AddBridgeToWorld();
 	
 		physics->SetupQuadtree();
 	}
 }
 
+// One navigation grid per level, shared read-only by every enemy- only parsed again when a different level is loaded,
+// or if the gate's opened or closed cells in it since it was (a reset level has to start from how the file has it).
+void CourseworkGame::LoadNavigationGrid(const std::string& file)
+{
+	// The gate's rebuilt with the rest of the world, so whichever grid's used has to be checked against it straight away.
+	gateCheckTimer = 0.0f;
+	if (levelGrid && levelGridFile == file && levelGrid->GetRevision() == 0)
+		return;
+
+	// The path workers must be done with the old grid before it goes.
+	pathService->SetLevel(nullptr);
+	delete chaseField;
+	delete levelHierarchy;
+	delete levelGrid;
+	levelGrid = new NavigationGrid(file, Vector3(-100, 0, -100));
+	// Every level is uniform cost with big open areas, which is exactly where jump point search pays off.
+	levelGrid->SetSearchMode(NavigationGrid::JUMP_POINT);
+	levelGridFile = file;
+	// Long trips (mostly enemies walking home) plan over clusters of the grid rather than every cell.
+	levelHierarchy = new HierarchicalGrid(*levelGrid, 10);
+
+	pathService->SetLevel(levelGrid, levelHierarchy);
+
+	// Nothing's worked out until enough enemies are chasing at once to be worth it- each system decides that every frame.
+	chaseField = new FlowField(*levelGrid);
+}
+
+// Whether anything solid (not a goose, enemy or item passing through) crosses the middle of a cell.
+// One ray along each axis, so a gate panel lying either way across the cell is caught.
+bool CourseworkGame::IsCellObstructed(int x, int y)
+{
+	Vector3 centre = levelGrid->CellToWorld(x, y) + Vector3(0, GATE_PROBE_HEIGHT, 0);
+	float halfCell = levelGrid->GetNodeSize() * 0.5f;
+	unsigned int solid = ~((1u << GameObject::PLAYER) | (1u << GameObject::NPC) | (1u << GameObject::ITEM));
+
+	RayCollision collision;
+	return physics->RaycastNearby(Ray(centre - Vector3(halfCell, 0, 0), Vector3(1, 0, 0)), collision, halfCell * 2.0f, solid, nullptr)
+		|| physics->RaycastNearby(Ray(centre - Vector3(0, 0, halfCell), Vector3(0, 0, 1)), collision, halfCell * 2.0f, solid, nullptr);
+}
+
+// The gate's the one part of the level that moves. Any cell round it that it's opened or closed since the last look is changed in the
+// navigation grid- the hierarchy's rebuilt straight away, and the incremental planners and flow field repair their searches from the
+// grid's revision the next time they're used.
+void CourseworkGame::UpdateGateNavigation(float dt)
+{
+	gateCheckTimer -= dt;
+	if (gateCheckTimer > 0.0f || !levelGrid)
+		return;
+	gateCheckTimer = GATE_CHECK_INTERVAL;
+
+	int gateX, gateY;
+	if (!levelGrid->WorldToCell(GATE_POSITION, gateX, gateY))
+		return;
+
+	bool paused = false;
+	for (int y = gateY - GATE_CELL_RADIUS; y <= gateY + GATE_CELL_RADIUS; ++y)
+	{
+		for (int x = gateX - GATE_CELL_RADIUS; x <= gateX + GATE_CELL_RADIUS; ++x)
+		{
+			if (levelGrid->IsBlockedByLevel(x, y))
+				continue;
+
+			bool open = !IsCellObstructed(x, y);
+			if (open == levelGrid->IsWalkable(x, y))
+				continue;
+
+			// The path workers read the grid without locking, so they have to be stood down while it changes.
+			if (!paused)
+			{
+				pathService->Pause();
+				paused = true;
+			}
+			levelGrid->SetWalkable(x, y, open);
+		}
+	}
+
+	if (!paused)
+		return;
+	if (levelHierarchy->IsOutOfDate())
+		levelHierarchy->Rebuild();
+	pathService->Resume();
+}
+
 /*
 * Main - the main menu of the game, choose between single player, client player, server player, or exit 
 * Single Player - start a game with no networking
@@ -638,67 +889,246 @@ void CourseworkGame::SetupNetworking()
 	if (gameType == CLIENT)
 	{
 		client = new GameClient();
-		clientReceiver = ClientPacketReceiver("Client", this, highScores);
-		client->RegisterPacketHandler(String_Message, &clientReceiver);
-		client->RegisterPacketHandler(Position_Message, &clientReceiver);
-		client->RegisterPacketHandler(Held_Item_Update, &clientReceiver);
-		client->RegisterPacketHandler(Player_Connected, &clientReceiver);
-		client->RegisterPacketHandler(Int_Message, &clientReceiver);
+		clientReceiver = ClientPacketReceiver("Client", this);
+		// Everything arrives batched- the scheduler unpacks each batch and the dispatcher hands each packet in it to the receiver function for its type.
+		packetDispatcher = new ClientPacketDispatcher(&clientReceiver);
+		// Batches come in and go out on the network thread- the scheduler only ever sees them once the game loop's drained them.
+		networkThread = new NetworkThread([this]() { client->UpdateClient(); }, [this](int peer, GamePacket& batch) { client->SendPacket(batch); });
+		networkScheduler = new NetworkScheduler(NETWORK_TICK_RATE, [this](GamePacket& batch) { networkThread->Send(0, batch); }, packetDispatcher);
+		client->RegisterPacketHandler(Message_Batch, networkThread);
 		connected = client->Connect(127, 0, 0, 1, port);
 		// Signal to the main game that it needs to update with a new player and send the appropriate packet.
 		if (connected)
 		{
 			newPlayerJoined = true;
+			// Only started once connecting's done with- from here on nothing else touches the client.
+			networkThread->Start();
 		}
 			
 	}
 		
 	else if (gameType == SERVER)
 	{
-		server = new GameServer(port, 1);
-		serverReceiver = ServerPacketReceiver("Server", this, sendHighScores);
-		server->RegisterPacketHandler(String_Message, &serverReceiver);
-		server->RegisterPacketHandler(Request, &serverReceiver);
-		server->RegisterPacketHandler(Position_Message, &serverReceiver);
-		server->RegisterPacketHandler(Client_Player_Input, &serverReceiver);
-		server->RegisterPacketHandler(Player_Connected, &serverReceiver);
+		server = new GameServer(port, MAX_CLIENTS);
+		// The server simulates at a fixed 60Hz so every client sees the same results no matter how fast the server renders.
+		physics->SetFixedTimestep(1.0f / 60.0f);
+		physics->SetMaxSubsteps(4);
+		serverReceiver = ServerPacketReceiver("Server", this);
+		// Read the once here- requests are answered from memory.
+		highScoreTable->Load(Assets::DATADIR + "HighScores.txt");
+		packetDispatcher = new ServerPacketDispatcher(&serverReceiver);
+		// Each client gets a session (and a scheduler) of its own the first time anything arrives from it.
+		networkThread = new NetworkThread([this]() { server->UpdateServer(); }, [this](int peer, GamePacket& batch) { server->SendPacketToPeer(peer, batch); });
+		sessions = new SessionManager(NETWORK_TICK_RATE, SESSION_TIMEOUT,
+			[this](int peer, GamePacket& batch) { networkThread->Send(peer, batch); }, packetDispatcher,
+			[this](ClientSession& session) { ServerRemoveClient(session); });
+		packetRecorder = new PacketRecorder(sessions);
+		server->RegisterPacketHandler(Message_Batch, networkThread);
+		networkThread->Start();
+	}
+}
+
+// Just the rows the client hasn't got- if it's up to date that's nothing but the version number.
+void CourseworkGame::SendHighScoreTable(int client, unsigned int knownTable, int knownVersion)
+{
+	ClientSession* session = sessions->Find(client);
+	if (!session)
+		return;
+
+	HighScoreUpdatePacket update;
+	highScoreTable->WriteChanges(knownTable, knownVersion, update);
+	session->scheduler->Send(update, HIGH_SCORE_CHANNEL, NetworkScheduler::RELIABLE);
+}
+
+// Every goose someone was playing gets its chance at the table.
+void CourseworkGame::ServerSubmitHighScores()
+{
+	bool changed = false;
+	for (auto& entry : sessions->GetSessions())
+	{
+		int index = entry.second.gooseIndex;
+		if (index >= 0 && highScoreTable->Submit("Goose " + std::to_string(index + 1), geese[index]->GetScore()))
+			changed = true;
 	}
+
+	if (changed)
+		highScoreTable->Save(Assets::DATADIR + "HighScores.txt");
 }
 
-void CourseworkGame::SendHighScoreTable()
+void CourseworkGame::ClientReadHighScores(const HighScoreUpdatePacket& packet)
 {
-	// Load the data from the high score file into a string
-	std::ifstream infile(Assets::DATADIR + "HighScores.txt");
-	std::stringstream scoreBuffer;
-	scoreBuffer << infile.rdbuf();
-	server->SendGlobalPacket(StringPacket(scoreBuffer.str()));
+	highScoreTable->ReadChanges(packet);
 }
 
 void CourseworkGame::DisplayHighScoreTable()
 {
 	renderer->DrawString("HIGH SCORES", Vector2(300, 600), Vector4(0, 0, 1, 1));
-	Debug::Print(highScores[0], Vector2(300, 450), Vector4(0, 1, 0, 1));
-	Debug::Print(highScores[1], Vector2(300, 400), Vector4(0, 1, 0, 1));
-	Debug::Print(highScores[2], Vector2(300, 350), Vector4(0, 1, 0, 1));
-	Debug::Print(highScores[3], Vector2(300, 300), Vector4(0, 1, 0, 1));
-	Debug::Print(highScores[4], Vector2(300, 250), Vector4(0, 1, 0, 1));
+	for (int i = 0; i < highScoreTable->GetCount(); ++i)
+	{
+		const HighScoreEntry& entry = highScoreTable->GetEntry(i);
+		Debug::Print(string(entry.name) + " " + std::to_string(entry.score), Vector2(300, 450 - 50.0f * i), Vector4(0, 1, 0, 1));
+	}
+}
+
+// Moves everything the server runs to match its snapshot, then picks up the timer and held item from it too.
+void CourseworkGame::ClientReadSnapshot(const SnapshotPacket& packet)
+{
+	if (!snapshotReceiver->Read(packet))
+		return;
+
+	// Only acknowledged once it's been decoded, so the server never deltas against one we haven't got.
+	networkScheduler->Send(SnapshotAckPacket(packet.sequence), SNAPSHOT_ACK_CHANNEL, NetworkScheduler::UNRELIABLE);
+
+	const WorldSnapshot& snapshot = snapshotReceiver->GetLatest();
+	ClientSetTimer(snapshot.timeRemaining);
+
+	// Nothing else in here is ours until we've been given a goose.
+	if (clientGooseIndex < 0)
+		return;
+
+	// Our goose has been running ahead of the server- put right wherever the two have drifted apart, keeping the moves it's not seen yet.
+	Vector3 serverPosition;
+	Quaternion serverOrientation;
+	if (snapshotReceiver->GetLatestTransform(playerGoose, serverPosition, serverOrientation))
+	{
+		Transform& transform = playerGoose->GetTransform();
+		Vector3 position = transform.GetWorldPosition();
+		Quaternion orientation = transform.GetLocalOrientation();
+
+		if (goosePrediction->Reconcile(snapshot.lastInput, serverPosition, serverOrientation, position, orientation))
+		{
+			transform.SetWorldPosition(position);
+			transform.SetLocalOrientation(orientation);
+		}
+	}
+
+	if (snapshot.heldItem != clientHeldItemID)
+	{
+		if (clientHeldItemID > -1)
+			ClientPickUpItem(-1);
+		if (snapshot.heldItem > -1)
+			ClientPickUpItem(snapshot.heldItem);
+		clientHeldItemID = snapshot.heldItem;
+	}
+	// Whatever we're holding was just moved to where the server had it- put it back on our own goose.
+	playerGoose->UpdateHeldItem();
 }
 
-void CourseworkGame::MoveKeeperForClients(Vector3 newPos)
+// Gives a newly joined client the first goose nobody else is playing, and starts it on full snapshots.
+void CourseworkGame::ServerAddClient(int client)
 {
-	keeper->GetTransform().SetWorldPosition(newPos);
+	ClientSession* session = sessions->Find(client);
+	if (!session)
+		return;
+
+	snapshotSender->AddClient(client);
+	if (session->gooseIndex < 0)
+	{
+		std::vector<bool> taken(geese.size(), false);
+		for (auto& entry : sessions->GetSessions())
+		{
+			if (entry.second.gooseIndex >= 0)
+				taken[entry.second.gooseIndex] = true;
+		}
+
+		for (int i = 0; i < (int)geese.size(); ++i)
+		{
+			if (taken[i])
+				continue;
+			session->gooseIndex = i;
+			break;
+		}
+	}
+
+	session->scheduler->Send(PlayerAssignPacket(session->gooseIndex), CONNECTION_CHANNEL, NetworkScheduler::RELIABLE);
 }
 
-void CourseworkGame::MoveGooseForServer(Vector3 force, float yTorque, float direction)
+// The client's gone- its goose is left where it is for the next one, minus whatever it was carrying.
+void CourseworkGame::ServerRemoveClient(ClientSession& session)
 {
-	// Must wake the goose up here as server applies no forces elsewhere to wake it up!
-	playerGoose->SetSleeping(false);
+	if (session.gooseIndex >= 0 && geese[session.gooseIndex]->IsHoldingItem())
+		geese[session.gooseIndex]->DropHeldItem();
+	snapshotSender->RemoveClient(session.peer);
+}
 
-	// Apply the sent values.
-	playerGoose->GetPhysicsObject()->AddForce(force);
-	playerGoose->GetPhysicsObject()->AddTorque(Vector3(0, yTorque, 0) * direction);
+void CourseworkGame::ServerAcknowledgeSnapshot(int client, int sequence)
+{
+	snapshotSender->Acknowledge(client, sequence);
+}
 
-	playerGoose->UpdateHeldItem();
+// The world's captured once, then each client gets its own snapshot of it- only what's near its goose, along with what it's holding and how far through its inputs the server is.
+void CourseworkGame::ServerSendSnapshots(float dt)
+{
+	snapshotSender->SetTimeRemaining((int)timeRemaining);
+	if (!snapshotSender->Update(dt))
+		return;
+
+	interestManager->Update();
+	for (auto& entry : sessions->GetSessions())
+	{
+		ClientSession& session = entry.second;
+		// Anyone watching sees what the server's camera does.
+		GooseObject* goose = session.gooseIndex >= 0 ? geese[session.gooseIndex] : playerGoose;
+		interestManager->UpdateRelevance(goose->GetTransform().GetWorldPosition(), session.relevant);
+
+		int heldItem = (session.gooseIndex >= 0 && goose->IsHoldingItem()) ? session.heldItemID : -1;
+		SnapshotPacket snapshot;
+		if (snapshotSender->Write(session.peer, heldItem, session.inputs.GetLastApplied(), &session.relevant, snapshot))
+			session.scheduler->Send(snapshot, SNAPSHOT_CHANNEL, NetworkScheduler::UNRELIABLE);
+	}
+}
+
+// Inputs arrive a network tick's worth at a time (and again until they're acknowledged)- queue the new ones up to be played out in order.
+void CourseworkGame::SetGooseInputForServer(int client, const GooseInputPacket& packet)
+{
+	ClientSession* session = sessions->Find(client);
+	if (session)
+		session->inputs.Receive(packet);
+}
+
+// Every goose someone's playing can be chased- just the one in single player, and each client's own on the server.
+void CourseworkGame::UpdateEnemyTargets()
+{
+	enemyTargets.clear();
+	if (gameType == SERVER)
+	{
+		for (auto& entry : sessions->GetSessions())
+		{
+			if (entry.second.gooseIndex >= 0)
+				enemyTargets.emplace_back(geese[entry.second.gooseIndex]);
+		}
+	}
+	else
+		enemyTargets.emplace_back(playerGoose);
+
+	enemyAI->SetTargets(enemyTargets);
+	keeperAI->SetTargets(enemyTargets);
+}
+
+void CourseworkGame::MoveGeeseForServer(float dt)
+{
+	for (auto& entry : sessions->GetSessions())
+	{
+		ClientSession& session = entry.second;
+		if (session.gooseIndex < 0)
+			continue;
+
+		GooseObject* goose = geese[session.gooseIndex];
+		// This frame's share of the client's inputs, each for exactly as long as it lasted there.
+		Vector3 force;
+		Vector3 torque;
+		if (session.inputs.Consume(dt, force, torque) && (force != Vector3(0, 0, 0) || torque != Vector3(0, 0, 0)))
+		{
+			// Must wake the goose up here as server applies no forces elsewhere to wake it up!
+			goose->SetSleeping(false);
+
+			goose->GetPhysicsObject()->AddForce(force);
+			goose->GetPhysicsObject()->AddTorque(torque);
+		}
+
+		// Any held item needs updating every frame to prevent gravity stealing it.
+		goose->UpdateHeldItem();
+	}
 
 	if (!world->GetMainCamera()->IsFreeCam())
 	{
@@ -712,54 +1142,66 @@ void CourseworkGame::MoveGooseForServer(Vector3 force, float yTorque, float dire
 
 // Server performs the raycast check for an object being in front of the client goose or not to maintain a consistent world state and allow the park keeper (run by server only) to detect 
 // when the goose has an item.
-void CourseworkGame::ServerPickUpItem()
+void CourseworkGame::ServerPickUpItem(int client)
 {
-	int itemID = -1; // If the client gets -1 back from this test, there was nothing to pick up.
+	ClientSession* session = sessions->Find(client);
+	if (!session || session->gooseIndex < 0)
+		return;
+	GooseObject* goose = geese[session->gooseIndex];
 
-	// Perform raycast test to determine if there's an item in front to pick up.
-	if (!playerGoose->IsHoldingItem())
+	// If there's an item in front, pick it up with this goose and change the ID to send back to the client.
+	if (!goose->IsHoldingItem())
 	{
-		Ray ray = Ray(playerGoose->GetTransform().GetWorldPosition(), playerGoose->GetTransform().GetWorldOrientation() * Vector3(0, 0, 1));
-		RayCollision closestCollision;
-
-		// If there is, pick up the item with this goose and change the ID to send back to the client.
-		if (world->Raycast(ray, closestCollision, playerGoose, true))
+		if (HeldItem* item = FindItemInFront(goose))
 		{
-			HeldItem* item = (HeldItem*)closestCollision.node;
-			if (closestCollision.rayDistance < 3.0f && closestCollision.rayDistance > 0)
-			{
-				playerGoose->PickUpItem(item);
-				itemID = item->GetItemID();
-			}
-				
+			goose->PickUpItem(item);
+			// The client finds out from the next snapshot.
+			session->heldItemID = item->GetItemID();
 		}
 	}
 	else
 	{
-		// Drop the held item and signal to the client that this right click was to drop an item.
-		playerGoose->DropHeldItem();
-		// An id longer than the number of items in the world signals it was dropped.
-		itemID = heldItemIDCounter + 1;
+		goose->DropHeldItem();
 	}
+}
 
-	// Tell the client what happened if anything. 
-	server->SendGlobalPacket(HeldItemUpdatePacket(itemID));
+// Send a ray out from the front of a goose for an item to pick up. Only items near enough to reach are tested, straight from the physics broadphase-
+// anything else in the way, or further along, doesn't matter.
+HeldItem* CourseworkGame::FindItemInFront(GooseObject* goose)
+{
+	Ray ray = Ray(goose->GetTransform().GetWorldPosition(), goose->GetTransform().GetWorldOrientation() * Vector3(0, 0, 1));
+	RayCollision closestCollision;
+
+	if (!physics->RaycastNearby(ray, closestCollision, PICKUP_RANGE, 1u << GameObject::ITEM, goose))
+		return nullptr;
+	if (closestCollision.rayDistance <= 0)
+		return nullptr;
+	return (HeldItem*)closestCollision.node;
+}
 
+// The server's said which goose is ours- from here on we move it ourselves rather than following the snapshots.
+void CourseworkGame::ClientAssignGoose(int index)
+{
+	if (index < 0 || index >= (int)geese.size())
+	{
+		clientGooseIndex = -1;
+		return;
+	}
+
+	clientGooseIndex = index;
+	playerGoose = geese[index];
+	snapshotReceiver->SetOwnedLocally(playerGoose);
+	goosePrediction->Clear();
 }
 
-// Get the item ID picked up from the server and give the appropriate item to the goose.
+// Get the item ID picked up from the server and give the appropriate item to the goose, or -1 to drop it.
 void CourseworkGame::ClientPickUpItem(int id)
 {
-	if (id < heldItemIDCounter + 1)
+	if (id > -1)
 	{
-		// Need to find the particular held item object with this ID. 
-		auto it = find_if(heldItemsInWorld.begin(), heldItemsInWorld.end(), [&id](const HeldItem* item) { return item->GetItemID() == id; });
-
-		if (it != heldItemsInWorld.end())
-		{
-			HeldItem* foundItem = *it;
-			playerGoose->PickUpItem(foundItem);
-		}
+		// IDs are handed out in the order items are added, so the ID is where it is in the list.
+		if (id < (int)heldItemsInWorld.size())
+			playerGoose->PickUpItem(heldItemsInWorld[id]);
 	}
 	else
 	{
@@ -0,0 +1,381 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Runs the AI for a whole group of enemies at once.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "EnemySystem.h"
+#include "EnemyObject.h"
+#include "GooseObject.h"
+#include "PathRequestService.h"
+#include "../CSC8503Common/FlowField.h"
+#include "../CSC8503Common/IncrementalPlanner.h"
+#include <algorithm>
+using namespace NCL;
+using namespace CSC8503;
+
+// Chasing enemies plan for themselves, so the path service only ever has enemies wandering home.
+const int RETURN_PATH_PRIORITY = 0;
+// How often a chasing enemy repairs its path to the goose.
+const float CHASE_REPLAN_INTERVAL = 0.1f;
+
+EnemySystem::EnemySystem(PathRequestService* pathService) : enemyHash(20.0f)
+{
+	this->pathService = pathService;
+	grid = nullptr;
+	flowField = nullptr;
+	minFlowFieldChasers = 1;
+	flowFieldTarget = nullptr;
+
+	chaseRadius = 20.0f;
+	// Initial positions are on the pathfinding grid, so they can be got back to pretty exactly.
+	homeRadius = 3.0f;
+}
+
+EnemySystem::~EnemySystem()
+{
+	Clear();
+}
+
+void EnemySystem::SetLevel(const NavigationGrid* grid, FlowField* flowField)
+{
+	this->grid = grid;
+	this->flowField = flowField;
+}
+
+int EnemySystem::AddEnemy(EnemyObject* enemy)
+{
+	int index = (int)objects.size();
+	Vector3 home = enemy->GetTransform().GetWorldPosition();
+
+	objects.emplace_back(enemy);
+	states.emplace_back(IDLE);
+	nextStates.emplace_back(IDLE);
+	positionX.emplace_back(home.x);
+	positionZ.emplace_back(home.z);
+	homeX.emplace_back(home.x);
+	homeZ.emplace_back(home.z);
+	nearestTargets.emplace_back(nullptr);
+	nearestDistances.emplace_back(0.0f);
+	chaseTargets.emplace_back(nullptr);
+	chaseStartScores.emplace_back(0);
+	homeDistances.emplace_back(0.0f);
+	replanTimers.emplace_back(0.0f);
+	pathForces.emplace_back(Vector3(0, 0, 0));
+	nodeTargets.emplace_back(Vector3(0, 0, 0));
+	moving.emplace_back(false);
+	paths.emplace_back();
+	returnRoutes.emplace_back();
+	planners.emplace_back(nullptr);
+
+	int handle = enemyHash.Add(home);
+	hashHandles.emplace_back(handle);
+	if (handle >= (int)handleOwners.size())
+		handleOwners.resize(handle + 1);
+	handleOwners[handle] = index;
+
+	enemy->SetSystem(this, index);
+	enemy->SetSleeping(true);
+	return index;
+}
+
+void EnemySystem::Clear()
+{
+	for (int i = 0; i < (int)objects.size(); ++i)
+	{
+		// Don't leave a path being worked out for an enemy that no longer exists.
+		pathService->CancelRequests(objects[i]);
+		delete planners[i];
+	}
+
+	objects.clear();
+	states.clear();
+	nextStates.clear();
+	positionX.clear();
+	positionZ.clear();
+	homeX.clear();
+	homeZ.clear();
+	nearestTargets.clear();
+	nearestDistances.clear();
+	chaseTargets.clear();
+	chaseStartScores.clear();
+	homeDistances.clear();
+	replanTimers.clear();
+	pathForces.clear();
+	nodeTargets.clear();
+	moving.clear();
+	paths.clear();
+	returnRoutes.clear();
+	planners.clear();
+	enemyHash.Clear();
+	hashHandles.clear();
+	handleOwners.clear();
+	chasing.clear();
+	returning.clear();
+}
+
+void EnemySystem::Update(float dt)
+{
+	if (objects.empty())
+		return;
+
+	int count = (int)objects.size();
+	for (int i = 0; i < count; ++i)
+	{
+		Vector3 position = objects[i]->GetTransform().GetWorldPosition();
+		positionX[i] = position.x;
+		positionZ[i] = position.z;
+		replanTimers[i] += dt;
+		// Only does any real work for the enemies that have crossed into a new cell.
+		enemyHash.Move(hashHandles[i], position);
+	}
+
+	// Behaviour first, then transitions- same order the state machine ran them in.
+	chaseSearches.clear();
+	chasing.clear();
+	returning.clear();
+	for (int i = 0; i < count; ++i)
+	{
+		if (states[i] == CHASE)
+			chasing.emplace_back(i);
+		else if (states[i] == RETURN)
+			returning.emplace_back(i);
+	}
+
+	ChooseFlowFieldTarget();
+
+	// Idle enemies don't do anything, so there's nothing to run for them.
+	for (int enemy : chasing)
+		UpdateChasing(enemy);
+	for (int enemy : returning)
+		UpdateReturning(enemy);
+
+	CheckTransitions();
+}
+
+bool EnemySystem::IsTarget(const GooseObject* goose) const
+{
+	return std::find(targets.begin(), targets.end(), goose) != targets.end();
+}
+
+// A shared field floods the whole grid every time its goose changes cell, which only pays for itself with a crowd chasing the same goose-
+// a handful of enemies each repairing their own search costs less. It goes to whichever goose has the most after it.
+void EnemySystem::ChooseFlowFieldTarget()
+{
+	flowFieldTarget = nullptr;
+	if (!flowField)
+		return;
+
+	int mostChasers = minFlowFieldChasers - 1;
+	for (GooseObject* target : targets)
+	{
+		int chasers = 0;
+		for (int enemy : chasing)
+		{
+			if (chaseTargets[enemy] == target)
+				chasers++;
+		}
+		if (chasers > mostChasers)
+		{
+			mostChasers = chasers;
+			flowFieldTarget = target;
+		}
+	}
+
+	// Only actually rebuilt when the goose has moved into a different grid cell.
+	if (flowFieldTarget && flowField->SetTarget(flowFieldTarget->GetTransform().GetWorldPosition()))
+		chaseSearches.emplace_back(flowField->GetLastStats());
+}
+
+// Every transition for every enemy at once. The distance home is a plain loop over the position arrays with no branches, so it vectorises.
+void EnemySystem::CheckTransitions()
+{
+	int count = (int)objects.size();
+
+	// Rather than every enemy measuring its distance to every goose, ask the hash which enemies are near each goose with an item.
+	std::fill(nearestTargets.begin(), nearestTargets.end(), nullptr);
+	for (GooseObject* target : targets)
+	{
+		if (!target->IsHoldingItem())
+			continue;
+
+		Vector3 targetPosition = target->GetTransform().GetWorldPosition();
+		enemyHash.QueryRadius(targetPosition, chaseRadius, queryResults);
+		for (int handle : queryResults)
+		{
+			int enemy = handleOwners[handle];
+			float dx = positionX[enemy] - targetPosition.x;
+			float dz = positionZ[enemy] - targetPosition.z;
+			float distance = dx * dx + dz * dz;
+			if (!nearestTargets[enemy] || distance < nearestDistances[enemy])
+			{
+				nearestTargets[enemy] = target;
+				nearestDistances[enemy] = distance;
+			}
+		}
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		float dx = positionX[i] - homeX[i];
+		float dz = positionZ[i] - homeZ[i];
+		homeDistances[i] = dx * dx + dz * dz;
+	}
+
+	float homeRadiusSq = homeRadius * homeRadius;
+
+	for (int i = 0; i < count; ++i)
+	{
+		bool atHome = homeDistances[i] < homeRadiusSq;
+		bool nearTarget = nearestTargets[i] != nullptr;
+
+		unsigned char state = states[i];
+		unsigned char next = state;
+
+		if (state == IDLE)
+			next = nearTarget ? CHASE : IDLE;
+		else if (state == CHASE)
+		{
+			// Either the goose got its item back to the island, it's been caught and dropped it, or whoever was playing it has left.
+			GooseObject* chased = chaseTargets[i];
+			bool chaseOver = !IsTarget(chased) || chased->GetScore() > chaseStartScores[i] || !chased->IsHoldingItem();
+			next = chaseOver ? RETURN : CHASE;
+		}
+		// Once home it stays there, otherwise go after a goose again if one passes with another item on the way.
+		// Home's checked first, as the state machine's return to idle transition was added before its return to chase.
+		else
+			next = atHome ? IDLE : (nearTarget ? CHASE : RETURN);
+
+		nextStates[i] = next;
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		if (nextStates[i] != states[i])
+			ChangeState(i, (EnemyState)nextStates[i]);
+	}
+}
+
+// Clears the pathfinding data, and wakes the enemy up- or sends it to sleep when going idle, so enemies aren't just standing there vibrating...
+void EnemySystem::ChangeState(int enemy, EnemyState newState)
+{
+	states[enemy] = newState;
+
+	pathService->CancelRequests(objects[enemy]);
+	paths[enemy].Clear();
+	returnRoutes[enemy].Clear();
+	pathForces[enemy] = Vector3(0, 0, 0);
+	moving[enemy] = false;
+	objects[enemy]->SetSleeping(newState == IDLE);
+
+	// Chases always start from a goose being near, so there's always one to go after.
+	if (newState == CHASE)
+	{
+		chaseTargets[enemy] = nearestTargets[enemy];
+		chaseStartScores[enemy] = chaseTargets[enemy]->GetScore();
+	}
+	else
+		chaseTargets[enemy] = nullptr;
+}
+
+void EnemySystem::UpdateChasing(int enemy)
+{
+	Vector3 startPos = Vector3(positionX[enemy], 0, positionZ[enemy]);
+	Vector3 endPos = chaseTargets[enemy]->GetTransform().GetWorldPosition();
+	endPos.y = 0;
+
+	float distanceBetween = (startPos - endPos).Length();
+	Vector3 moveTo;
+
+	// If too close to the target, pathfinding unnecessary and may not be found due to the navgrid size so just move along a simple direction vector.
+	if (distanceBetween < grid->GetNodeSize())
+	{
+		pathForces[enemy] = (endPos - startPos).Normalised() * 10.0f;
+	}
+	// With a crowd chasing the same goose, they all share the one flow field towards it, so it's just a lookup from wherever we are.
+	else if (chaseTargets[enemy] == flowFieldTarget && flowField->GetNextPosition(startPos, moveTo))
+	{
+		moveTo.y = 0;
+		pathForces[enemy] = (moveTo - startPos).Normalised() * 10.0f;
+	}
+	// Otherwise plan our own way there. The planner repairs its last search rather than starting again, so it can keep up with the goose far more often than a fresh A* could.
+	else if (replanTimers[enemy] >= CHASE_REPLAN_INTERVAL)
+	{
+		replanTimers[enemy] = 0;
+
+		if (!planners[enemy])
+			planners[enemy] = new IncrementalPlanner(*grid);
+
+		bool found = planners[enemy]->FindPath(startPos, endPos, paths[enemy]);
+		chaseSearches.emplace_back(planners[enemy]->GetLastStats());
+		if (found)
+		{
+			// Toss the first waypoint since this will usually be the enemy's actual grid position.
+			paths[enemy].PopWaypoint(moveTo);
+
+			// Now we can get the first actual point to move to.
+			paths[enemy].PopWaypoint(moveTo);
+
+			moveTo.y = 0;
+			pathForces[enemy] = (moveTo - startPos).Normalised() * 10.0f;
+		}
+	}
+
+	objects[enemy]->GetPhysicsObject()->AddForce(pathForces[enemy]);
+}
+
+// Returning to initial position after the goose has returned an item or lost one.
+void EnemySystem::UpdateReturning(int enemy)
+{
+	// Update force
+	Vector3 moveFrom = objects[enemy]->GetTransform().GetWorldPosition();
+	pathForces[enemy] = (nodeTargets[enemy] - moveFrom).Normalised() * 10.0f;
+
+	// If there's no best path to follow, ask for one, and pick it up once it's been worked out.
+	bool found;
+	pathService->TakeResult(objects[enemy], paths[enemy], returnRoutes[enemy], found);
+
+	// Long way home comes back a cluster at a time- expand the next stretch once the last one's been walked.
+	if (paths[enemy].IsEmpty() && !returnRoutes[enemy].IsFinished())
+		returnRoutes[enemy].NextSegment(paths[enemy]);
+
+	if (paths[enemy].IsEmpty() && !pathService->IsWaiting(objects[enemy]))
+	{
+		Vector3 endPos = Vector3(homeX[enemy], 0, homeZ[enemy]);
+		pathService->RequestPath(objects[enemy], moveFrom, endPos, RETURN_PATH_PRIORITY);
+	}
+	// If we have a path to follow, but haven't started moving yet.
+	if (!paths[enemy].IsEmpty() && !moving[enemy])
+	{
+		Vector3 moveTo;
+		paths[enemy].PopWaypoint(moveTo);
+		paths[enemy].PopWaypoint(moveTo);
+
+		moving[enemy] = true;
+		nodeTargets[enemy] = moveTo;
+	}
+	// If the next target has been decided, apply force to move in that direction before moving onto the next target step.
+	if (moving[enemy])
+	{
+		Vector3 targetPos = nodeTargets[enemy];
+		targetPos.y = moveFrom.y;
+		float length = (moveFrom - targetPos).Length();
+
+		// Close enough to the waypoint to move on to the next node.
+		if (length < 2.0f)
+			moving[enemy] = false;
+		else
+			objects[enemy]->GetPhysicsObject()->AddForce(pathForces[enemy]);
+	}
+}
+
+void EnemySystem::BounceOff(int enemy)
+{
+	pathForces[enemy] = -pathForces[enemy];
+	objects[enemy]->GetPhysicsObject()->AddForce(pathForces[enemy]);
+	replanTimers[enemy] = 10.0f;
+}
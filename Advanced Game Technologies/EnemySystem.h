@@ -0,0 +1,124 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Runs the AI for a whole group of enemies at once.
+Rather than every enemy owning a state machine full of heap allocated states and transitions called through void pointers,
+the state, timers and targets of every enemy live side by side in arrays here: transitions are checked for everyone in a couple of tight loops,
+then each state's behaviour is run over just the enemies currently in it.
+Any number of geese can be targets (one per client on the server). An enemy goes after the nearest goose carrying an item, and sticks with
+that one until the chase is over.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "../CSC8503Common/NavigationGrid.h"
+#include "../CSC8503Common/HierarchicalGrid.h"
+#include "../CSC8503Common/SpatialHash.h"
+#include <vector>
+
+namespace NCL {
+	namespace CSC8503 {
+		class EnemyObject;
+		class GooseObject;
+		class FlowField;
+		class IncrementalPlanner;
+		class PathRequestService;
+
+		class EnemySystem
+		{
+		public:
+			enum EnemyState : unsigned char
+			{
+				IDLE,
+				CHASE,
+				RETURN,
+			};
+
+			EnemySystem(PathRequestService* pathService);
+			~EnemySystem();
+
+			// Everything shared by the group for the current level. The flow field is optional.
+			void SetLevel(const NavigationGrid* grid, FlowField* flowField);
+			// Every goose that can be chased. Can change from frame to frame- an enemy chasing a goose that's no longer here gives up.
+			void SetTargets(const std::vector<GooseObject*>& targets) { this->targets = targets; }
+			// How many have to be chasing at once before they share the flow field rather than planning for themselves.
+			void SetMinFlowFieldChasers(int chasers) { minFlowFieldChasers = chasers; }
+
+			int AddEnemy(EnemyObject* enemy);
+			// Forget every enemy, e.g. before the world they're in gets erased.
+			void Clear();
+
+			void Update(float dt);
+
+			// Knocked back off something (the edge of the water)- reverse and work out a new path.
+			void BounceOff(int enemy);
+
+			EnemyState GetState(int enemy) const { return (EnemyState)states[enemy]; }
+			int GetEnemyCount() const { return (int)objects.size(); }
+
+			void SetChaseRadius(float radius) { chaseRadius = radius; }
+
+			// Every search run for a chase (planner repairs and flow field rebuilds) in the last Update- for profiling.
+			const std::vector<NavigationSearchStats>& GetChaseSearches() const { return chaseSearches; }
+
+		protected:
+			bool IsTarget(const GooseObject* goose) const;
+			void ChooseFlowFieldTarget();
+			void CheckTransitions();
+			void ChangeState(int enemy, EnemyState newState);
+
+			void UpdateChasing(int enemy);
+			void UpdateReturning(int enemy);
+
+			PathRequestService* pathService;
+			std::vector<GooseObject*> targets;
+			const NavigationGrid* grid;
+			FlowField* flowField;
+			int minFlowFieldChasers;
+			// Worked out each frame from how many are chasing each goose- nullptr if nobody's using the field.
+			GooseObject* flowFieldTarget;
+
+			float chaseRadius;
+			float homeRadius;
+
+			// One entry per enemy in all of these.
+			std::vector<EnemyObject*> objects;
+			std::vector<unsigned char> states;
+			std::vector<unsigned char> nextStates;
+			std::vector<float> positionX;
+			std::vector<float> positionZ;
+			std::vector<float> homeX;
+			std::vector<float> homeZ;
+			// The nearest goose carrying an item within the chase radius this frame, if there is one, and how far away squared.
+			std::vector<GooseObject*> nearestTargets;
+			std::vector<float> nearestDistances;
+			// Who each enemy's chasing, and their score when it started- if it goes up, the item's been got back to the island.
+			std::vector<GooseObject*> chaseTargets;
+			std::vector<int> chaseStartScores;
+			std::vector<float> homeDistances;
+			std::vector<float> replanTimers;
+			std::vector<Vector3> pathForces;
+			std::vector<Vector3> nodeTargets;
+			std::vector<unsigned char> moving;
+			std::vector<NavigationPath> paths;
+			std::vector<HierarchicalPath> returnRoutes;
+			// Only made the first time an enemy has to plan its own chase, since each one is as big as the grid.
+			std::vector<IncrementalPlanner*> planners;
+
+			// Where every enemy is, so proximity checks go from the few targets out to the enemies near them rather than every enemy to every target.
+			SpatialHash enemyHash;
+			std::vector<int> hashHandles;
+			std::vector<int> handleOwners;
+			std::vector<int> queryResults;
+
+			// Which enemies are in each state this frame.
+			std::vector<int> chasing;
+			std::vector<int> returning;
+
+			std::vector<NavigationSearchStats> chaseSearches;
+		};
+	}
+}
@@ -0,0 +1,131 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A flow field over a navigation grid towards a single target.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "FlowField.h"
+#include <chrono>
+using namespace NCL;
+using namespace CSC8503;
+
+FlowField::FlowField(const NavigationGrid& grid) : grid(grid)
+{
+	targetCell = -1;
+	builtRevision = 0;
+	lastStats.nodesExpanded = 0;
+	lastStats.milliseconds = 0.0f;
+}
+
+bool FlowField::SetTarget(const Vector3& target)
+{
+	int x, y;
+	if (!grid.WorldToCell(target, x, y) || !grid.IsWalkable(x, y))
+		return false;
+
+	int cell = grid.CellIndex(x, y);
+	if (cell == targetCell && builtRevision == grid.GetRevision())
+		return false;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	targetCell = cell;
+	builtRevision = grid.GetRevision();
+	BuildIntegrationField();
+	BuildDirectionField();
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	lastStats.nodesExpanded = (int)frontier.size();
+	lastStats.milliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+	return true;
+}
+
+// Every move costs the same, so a breadth first flood out from the target gives the same distances Dijkstra would.
+void FlowField::BuildIntegrationField()
+{
+	int width = grid.GetWidth();
+	distances.assign(width * grid.GetHeight(), -1);
+
+	frontier.clear();
+	frontier.emplace_back(targetCell);
+	distances[targetCell] = 0;
+
+	const int dx[4] = { 0, 0, -1, 1 };
+	const int dy[4] = { -1, 1, 0, 0 };
+
+	for (size_t i = 0; i < frontier.size(); ++i)
+	{
+		int cell = frontier[i];
+		int x = cell % width;
+		int y = cell / width;
+
+		for (int d = 0; d < 4; ++d)
+		{
+			int nx = x + dx[d];
+			int ny = y + dy[d];
+			if (!grid.IsWalkable(nx, ny))
+				continue;
+
+			int neighbour = grid.CellIndex(nx, ny);
+			if (distances[neighbour] >= 0)
+				continue;
+
+			distances[neighbour] = distances[cell] + 1;
+			frontier.emplace_back(neighbour);
+		}
+	}
+}
+
+// Point every cell at its lowest cost neighbour. Diagonals are allowed when both sides are open so enemies don't zig-zag across open ground.
+void FlowField::BuildDirectionField()
+{
+	int width = grid.GetWidth();
+	nextCells.assign(distances.size(), -1);
+
+	for (int cell : frontier)
+	{
+		int x = cell % width;
+		int y = cell / width;
+		int best = distances[cell];
+
+		for (int ny = y - 1; ny <= y + 1; ++ny)
+		{
+			for (int nx = x - 1; nx <= x + 1; ++nx)
+			{
+				if ((nx == x && ny == y) || !grid.IsWalkable(nx, ny))
+					continue;
+
+				// No cutting corners round walls.
+				if (nx != x && ny != y && (!grid.IsWalkable(nx, y) || !grid.IsWalkable(x, ny)))
+					continue;
+
+				int neighbour = grid.CellIndex(nx, ny);
+				if (distances[neighbour] >= 0 && distances[neighbour] < best)
+				{
+					best = distances[neighbour];
+					nextCells[cell] = neighbour;
+				}
+			}
+		}
+	}
+}
+
+bool FlowField::GetNextPosition(const Vector3& from, Vector3& outPosition) const
+{
+	int x, y;
+	if (targetCell < 0 || !grid.WorldToCell(from, x, y))
+		return false;
+
+	int cell = grid.CellIndex(x, y);
+	if (distances[cell] < 0)
+		return false;
+
+	// Already in the target's cell, so head for its centre.
+	int next = nextCells[cell] >= 0 ? nextCells[cell] : cell;
+	outPosition = grid.CellToWorld(next % grid.GetWidth(), next / grid.GetWidth());
+	return true;
+}
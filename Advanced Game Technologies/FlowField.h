@@ -0,0 +1,51 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A flow field over a navigation grid towards a single target.
+Worked out once whenever the target moves to a new cell, then any number of enemies can look up which way to go from wherever they are.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "NavigationGrid.h"
+#include <vector>
+
+namespace NCL {
+	namespace CSC8503 {
+		class FlowField
+		{
+		public:
+			FlowField(const NavigationGrid& grid);
+			~FlowField() {}
+
+			// Rebuilds the field only if the target has moved into a different cell, or the grid itself has changed. Returns true if it did.
+			bool SetTarget(const Vector3& target);
+
+			// Where to head next from this position- the centre of the neighbouring cell that's closest to the target.
+			// False if the position is off the grid, blocked, or can't reach the target at all.
+			bool GetNextPosition(const Vector3& from, Vector3& outPosition) const;
+
+			bool HasTarget() const { return targetCell >= 0; }
+			// From the last rebuild- every reachable cell is expanded once.
+			const NavigationSearchStats& GetLastStats() const { return lastStats; }
+
+		protected:
+			void BuildIntegrationField();
+			void BuildDirectionField();
+
+			const NavigationGrid& grid;
+			int targetCell;
+			int builtRevision;
+
+			// Steps from each cell to the target (-1 for unreachable), and the index of the cell to move to next from each one.
+			std::vector<int> distances;
+			std::vector<int> nextCells;
+
+			std::vector<int> frontier;
+			NavigationSearchStats lastStats;
+		};
+	}
+}
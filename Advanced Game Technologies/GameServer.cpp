@@ -0,0 +1,29 @@
+#include "GameServer.h"
+#include "GameWorld.h"
+#include <iostream>
+
+/* Only a selection of functions of the game server are given as example here to demonstrate sending to a single client rather than all of them. */
+
+using namespace NCL;
+using namespace CSC8503;
+
+// Everything the server sends is per client now- what each one gets depends on where it is.
+// The peer's the same ID its own packets arrive with.
+bool GameServer::SendPacketToPeer(int peerID, GamePacket& packet)
+{
+	if (!netHandle || peerID < 0 || peerID >= (int)netHandle->peerCount)
+		return false;
+
+	ENetPeer* peer = &netHandle->peers[peerID];
+	if (peer->state != ENET_PEER_STATE_CONNECTED)
+		return false;
+
+	ENetPacket* dataPacket = enet_packet_create(&packet, packet.GetTotalSize(), 0);
+	// ENet only takes ownership of packets it actually queues.
+	if (enet_peer_send(peer, 0, dataPacket) < 0)
+	{
+		enet_packet_destroy(dataPacket);
+		return false;
+	}
+	return true;
+}
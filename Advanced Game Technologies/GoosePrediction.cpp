@@ -0,0 +1,295 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Client side prediction for the goose, corrected by replaying unacknowledged moves over the server's state.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "GoosePrediction.h"
+#include "BitStream.h"
+#include <algorithm>
+#include <cmath>
+using namespace NCL;
+using namespace CSC8503;
+
+// Smaller differences than these are just quantisation in the snapshots, and correcting them would only make the goose jitter.
+const float POSITION_TOLERANCE = 0.05f;
+const float ORIENTATION_TOLERANCE = 0.9998f; // dot product, about 2 degrees
+// Longer than any real frame- stops a client buying its goose extra push by claiming its frames took forever.
+const float MAX_INPUT_TIME = 0.25f;
+
+// Pushes go up to 128 either way, which leaves room for a jump.
+const float INPUT_STEPS_PER_UNIT = 16.0f;
+const int INPUT_STEP_MIN = -2048;
+const int INPUT_STEP_MAX = 2047;
+const int INPUT_AXES = 6;
+
+/* QUANTISATION */
+
+short QuantiseInputAxis(float value)
+{
+	int step = (int)floorf(value * INPUT_STEPS_PER_UNIT + 0.5f);
+	return (short)(step < INPUT_STEP_MIN ? INPUT_STEP_MIN : (step > INPUT_STEP_MAX ? INPUT_STEP_MAX : step));
+}
+
+float NCL::CSC8503::DequantiseTime(const GooseInput& input)
+{
+	return input.dt / 1000.0f;
+}
+
+Vector3 NCL::CSC8503::DequantiseForce(const GooseInput& input)
+{
+	return Vector3(input.force[0], input.force[1], input.force[2]) * (1.0f / INPUT_STEPS_PER_UNIT);
+}
+
+Vector3 NCL::CSC8503::DequantiseTorque(const GooseInput& input)
+{
+	return Vector3(input.torque[0], input.torque[1], input.torque[2]) * (1.0f / INPUT_STEPS_PER_UNIT);
+}
+
+/* ENCODING */
+
+// Each input as a delta against the one before it (the first against no push at all). Holding a key down with the camera still only changes
+// the torque as the goose turns, so most axes cost a single bit.
+int WriteInputData(const GooseInput* inputs, int count, char* buffer, int capacityBytes)
+{
+	BitWriter writer(buffer, capacityBytes);
+	writer.WriteInt(count, 0, MAX_GOOSE_INPUTS);
+
+	short previous[INPUT_AXES] = {};
+	for (int i = 0; i < count; ++i)
+	{
+		writer.WriteBits(inputs[i].dt, 8);
+		for (int axis = 0; axis < INPUT_AXES; ++axis)
+		{
+			short value = axis < 3 ? inputs[i].force[axis] : inputs[i].torque[axis - 3];
+			bool changed = value != previous[axis];
+			writer.WriteBool(changed);
+			if (changed)
+				writer.WriteInt(value, INPUT_STEP_MIN, INPUT_STEP_MAX);
+			previous[axis] = value;
+		}
+	}
+	return writer.HasOverflowed() ? -1 : writer.GetBytesWritten();
+}
+
+// Returns how many inputs there were, or -1 if the data doesn't hold what it says it does.
+int ReadInputData(const char* buffer, int sizeBytes, GooseInput* outInputs)
+{
+	BitReader reader(buffer, sizeBytes);
+	int count = reader.ReadInt(0, MAX_GOOSE_INPUTS);
+
+	short previous[INPUT_AXES] = {};
+	for (int i = 0; i < count; ++i)
+	{
+		outInputs[i].dt = (unsigned char)reader.ReadBits(8);
+		for (int axis = 0; axis < INPUT_AXES; ++axis)
+		{
+			if (reader.ReadBool())
+				previous[axis] = (short)reader.ReadInt(INPUT_STEP_MIN, INPUT_STEP_MAX);
+			if (axis < 3)
+				outInputs[i].force[axis] = previous[axis];
+			else
+				outInputs[i].torque[axis - 3] = previous[axis];
+		}
+	}
+	return reader.HasOverflowed() ? -1 : count;
+}
+
+/* CLIENT */
+
+GoosePrediction::GoosePrediction()
+{
+	Clear();
+}
+
+void GoosePrediction::Clear()
+{
+	oldestSequence = 0;
+	nextSequence = 0;
+	timeRemainder = 0.0f;
+}
+
+GooseInput GoosePrediction::QuantiseInput(float dt, const Vector3& force, const Vector3& torque)
+{
+	GooseInput input;
+	float time = dt + timeRemainder;
+	int milliseconds = (int)floorf(time * 1000.0f + 0.5f);
+	input.dt = (unsigned char)(milliseconds < 0 ? 0 : (milliseconds > 255 ? 255 : milliseconds));
+	timeRemainder = time - DequantiseTime(input);
+	// Only the rounding's carried- a frame too long for a byte to hold is just cut short, like the server would anyway.
+	if (fabsf(timeRemainder) > 0.001f)
+		timeRemainder = 0.0f;
+	input.force[0] = QuantiseInputAxis(force.x);
+	input.force[1] = QuantiseInputAxis(force.y);
+	input.force[2] = QuantiseInputAxis(force.z);
+	input.torque[0] = QuantiseInputAxis(torque.x);
+	input.torque[1] = QuantiseInputAxis(torque.y);
+	input.torque[2] = QuantiseInputAxis(torque.z);
+	return input;
+}
+
+int GoosePrediction::RecordInput(const Vector3& position, const Quaternion& orientation, const GooseInput& input)
+{
+	// Drop the oldest if the server's fallen a long way behind- it'll just be corrected against whatever's left.
+	if (nextSequence - oldestSequence >= HISTORY_SIZE)
+		oldestSequence++;
+
+	PredictedPose& pose = history[nextSequence % HISTORY_SIZE];
+	pose.position = position;
+	pose.orientation = orientation;
+	pose.input = input;
+	return nextSequence++;
+}
+
+void GoosePrediction::Acknowledge(int acknowledged)
+{
+	if (acknowledged >= oldestSequence && acknowledged < nextSequence)
+		oldestSequence = acknowledged + 1;
+}
+
+void GoosePrediction::WriteInputs(GooseInputPacket& packet) const
+{
+	packet.firstSequence = std::max(oldestSequence, nextSequence - MAX_GOOSE_INPUTS);
+	int count = nextSequence - packet.firstSequence;
+	GooseInput inputs[MAX_GOOSE_INPUTS];
+	for (int i = 0; i < count; ++i)
+		inputs[i] = history[(packet.firstSequence + i) % HISTORY_SIZE].input;
+	// The buffer has room for the worst case, so this always fits.
+	packet.SetDataSize(WriteInputData(inputs, count, packet.data, MAX_GOOSE_INPUT_BYTES));
+}
+
+bool GoosePrediction::Reconcile(int acknowledged, const Vector3& serverPosition, const Quaternion& serverOrientation,
+	Vector3& position, Quaternion& orientation)
+{
+	if (acknowledged < oldestSequence || acknowledged >= nextSequence)
+		return false;
+
+	// Where we had the goose once that input had been applied- just before the next one, or right now if it's the latest.
+	PredictedPose predicted;
+	if (acknowledged + 1 < nextSequence)
+		predicted = history[(acknowledged + 1) % HISTORY_SIZE];
+	else
+	{
+		predicted.position = position;
+		predicted.orientation = orientation;
+	}
+
+	// Everything up to and including the acknowledged input is settled now.
+	oldestSequence = acknowledged + 1;
+
+	Vector3 error = serverPosition - predicted.position;
+	float agreement = fabsf(Quaternion::Dot(serverOrientation, predicted.orientation));
+	if (error.Length() < POSITION_TOLERANCE && agreement > ORIENTATION_TOLERANCE)
+		return false;
+
+	// Replaying every move since on top of the server's goose is the same as moving it, and everything still remembered, by the difference.
+	// The rotation taking our goose to the server's goes on the left, so it's applied after everything each pose has turned through since.
+	Quaternion correction = serverOrientation * predicted.orientation.Conjugate();
+	for (int sequence = oldestSequence; sequence < nextSequence; ++sequence)
+	{
+		PredictedPose& pose = history[sequence % HISTORY_SIZE];
+		pose.position = pose.position + error;
+		pose.orientation = correction * pose.orientation;
+		pose.orientation.Normalise();
+	}
+
+	position = position + error;
+	orientation = correction * orientation;
+	orientation.Normalise();
+	return true;
+}
+
+/* SERVER */
+
+GooseInputQueue::GooseInputQueue()
+{
+	Clear();
+}
+
+void GooseInputQueue::Clear()
+{
+	front = 0;
+	queued = 0;
+	frontLeft = 0.0f;
+	lastQueued = -1;
+	lastApplied = -1;
+}
+
+bool GooseInputQueue::Receive(const GooseInputPacket& packet)
+{
+	if (packet.GetDataSize() < 0 || packet.GetDataSize() > MAX_GOOSE_INPUT_BYTES)
+		return false;
+
+	GooseInput inputs[MAX_GOOSE_INPUTS];
+	int count = ReadInputData(packet.data, packet.GetDataSize(), inputs);
+	if (count < 0)
+		return false;
+
+	for (int i = 0; i < count; ++i)
+	{
+		int sequence = packet.firstSequence + i;
+		// Already got it from an earlier packet.
+		if (sequence <= lastQueued)
+			continue;
+
+		// The client's run this far ahead of us- the oldest is given up on, and the snapshots will put the difference right.
+		if (queued == QUEUE_SIZE)
+		{
+			lastApplied = queue[front].sequence;
+			front = (front + 1) % QUEUE_SIZE;
+			queued--;
+			frontLeft = queue[front].time;
+		}
+
+		QueuedInput& entry = queue[(front + queued) % QUEUE_SIZE];
+		entry.sequence = sequence;
+		entry.time = std::min(MAX_INPUT_TIME, DequantiseTime(inputs[i]));
+		entry.force = DequantiseForce(inputs[i]);
+		entry.torque = DequantiseTorque(inputs[i]);
+		if (queued == 0)
+			frontLeft = entry.time;
+		queued++;
+		lastQueued = sequence;
+	}
+	return true;
+}
+
+// Played out in time rather than one per server frame, so each input pushes the goose for as long as it pushed the client's.
+// Any inputs skipped over because they never arrived simply aren't played, and the first one after them is applied as normal.
+bool GooseInputQueue::Consume(float dt, Vector3& force, Vector3& torque)
+{
+	force = Vector3(0, 0, 0);
+	torque = Vector3(0, 0, 0);
+	if (dt <= 0.0f || queued == 0)
+		return false;
+
+	Vector3 impulse;
+	Vector3 angularImpulse;
+	float remaining = dt;
+	while (remaining > 0.0f && queued > 0)
+	{
+		QueuedInput& entry = queue[front];
+		float used = std::min(remaining, frontLeft);
+		impulse = impulse + entry.force * used;
+		angularImpulse = angularImpulse + entry.torque * used;
+		remaining -= used;
+		frontLeft -= used;
+
+		if (frontLeft <= 0.0f)
+		{
+			lastApplied = entry.sequence;
+			front = (front + 1) % QUEUE_SIZE;
+			queued--;
+			frontLeft = queued > 0 ? queue[front].time : 0.0f;
+		}
+	}
+
+	// Physics takes it as a force over the frame, so the push it gives adds up to the inputs' own.
+	force = impulse * (1.0f / dt);
+	torque = angularImpulse * (1.0f / dt);
+	return true;
+}
@@ -0,0 +1,157 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Client side prediction for the goose. The client moves its own goose straight away rather than waiting on the server, numbering every frame's input
+and remembering where the goose was when it made it. Every input the server hasn't acknowledged goes in each one sent, along with how long the frame
+it was made in lasted, and the server applies each one for exactly that long- so once it's applied input N its goose has had the same pushes the client's
+had. Snapshots say which input the server had got all the way through, so when one comes in the moves made since that input are replayed on top of
+where the server had the goose- any difference between the two simulations gets corrected without undoing the moves the server hasn't seen yet.
+Inputs are rounded off as they're made (frame times to the millisecond, pushes to 1/16 of a unit) and the client pushes its own goose by the rounded
+values, so both ends apply exactly the same thing. They're bit-packed as deltas against the input before, so a held key costs a bit per axis.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "../CSC8503Common/NetworkBase.h"
+#include "PacketDispatcher.h"
+#include "../../Common/Vector3.h"
+#include "../../Common/Quaternion.h"
+
+using namespace NCL::Maths;
+
+namespace NCL {
+	namespace CSC8503 {
+		// About a fifth of a second at 144fps- anything the server's further behind than that it just misses.
+		const int MAX_GOOSE_INPUTS = 32;
+		// Enough for every input to have changed every axis.
+		const int MAX_GOOSE_INPUT_BYTES = 352;
+
+		// One frame's worth of movement from the client, made every frame whether the goose is moving or not so the numbering never stalls.
+		// Kept as it's sent- the frame time in milliseconds, and the force and torque in 1/16ths of a unit.
+		struct GooseInput
+		{
+			unsigned char dt;
+			short force[3];
+			short torque[3];
+		};
+
+		float DequantiseTime(const GooseInput& input);
+		Vector3 DequantiseForce(const GooseInput& input);
+		Vector3 DequantiseTorque(const GooseInput& input);
+
+		// Every input the server hasn't acknowledged yet (or the newest of them, if there's more than fit), in order.
+		// Each one sent has everything the last one did that's still outstanding, so nothing's lost when a newer one replaces it before a tick.
+		struct GooseInputPacket : public GamePacket
+		{
+			int firstSequence;
+			char data[MAX_GOOSE_INPUT_BYTES];
+
+			GooseInputPacket()
+			{
+				type = Goose_Input;
+				firstSequence = 0;
+				SetDataSize(0);
+			}
+
+			// Only the bytes actually written go over the wire.
+			void SetDataSize(int bytes) { size = (short)(sizeof(int) + bytes); }
+			int GetDataSize() const { return size - (int)sizeof(int); }
+		};
+
+		template <>
+		struct PacketTraits<GooseInputPacket>
+		{
+			static const int Type = Goose_Input;
+			static const int MinSize = sizeof(int);
+		};
+
+		class GoosePrediction
+		{
+		public:
+			GoosePrediction();
+			~GoosePrediction() {}
+
+			// Rounds a frame's movement off to what gets sent. Each frame time's rounding is carried over to the next, so in total the server
+			// plays inputs out for just as long as they lasted here rather than slowly falling behind.
+			GooseInput QuantiseInput(float dt, const Vector3& force, const Vector3& torque);
+			// Remembers where the goose is as a new input's made, and the input itself. Returns its number.
+			int RecordInput(const Vector3& position, const Quaternion& orientation, const GooseInput& input);
+			// Fills in every input the server hasn't acknowledged yet, or the newest that fit.
+			void WriteInputs(GooseInputPacket& packet) const;
+
+			// The server's goose after it had applied input acknowledged. Fills in where the goose should be now- false if there's nothing worth correcting.
+			bool Reconcile(int acknowledged, const Vector3& serverPosition, const Quaternion& serverOrientation,
+				Vector3& position, Quaternion& orientation);
+
+			// Everything up to and including this input's been applied by the server, so it needn't be sent again. Reconcile does this too.
+			void Acknowledge(int acknowledged);
+
+			void Clear();
+
+			int GetLatestSequence() const { return nextSequence - 1; }
+
+		protected:
+			struct PredictedPose
+			{
+				Vector3 position;
+				Quaternion orientation;
+				GooseInput input;
+			};
+
+			static const int HISTORY_SIZE = 256;
+
+			// Where the goose was just before each input still waiting on the server, and the input.
+			PredictedPose history[HISTORY_SIZE];
+			int oldestSequence;
+			int nextSequence;
+			// How much longer the inputs so far lasted here than they were sent as lasting.
+			float timeRemainder;
+		};
+
+		// The server's end- a client's inputs queued up in order, and played out over the server's frames for exactly as long as each one lasted on the client.
+		class GooseInputQueue
+		{
+		public:
+			GooseInputQueue();
+			~GooseInputQueue() {}
+
+			// Queues anything in the packet that hasn't been queued already. Anything skipped over (lost for good) is treated as applied.
+			// False if the packet doesn't hold what it says it does.
+			bool Receive(const GooseInputPacket& packet);
+
+			// The average force and torque over the next dt of queued input. Nothing queued for some of it counts as no push for that part.
+			// False if there was no input at all.
+			bool Consume(float dt, Vector3& force, Vector3& torque);
+
+			// The newest input that's been played out in full- what snapshots are stamped with.
+			int GetLastApplied() const { return lastApplied; }
+			int GetLastQueued() const { return lastQueued; }
+
+			void Clear();
+
+		protected:
+			static const int QUEUE_SIZE = 64;
+
+			struct QueuedInput
+			{
+				int sequence;
+				float time;
+				Vector3 force;
+				Vector3 torque;
+			};
+
+			// A ring of inputs waiting to be played out, oldest at the front.
+			QueuedInput queue[QUEUE_SIZE];
+			int front;
+			int queued;
+			// How much of the front input's still to be played out.
+			float frontLeft;
+			// The newest sequence ever queued, so repeats in later packets are skipped.
+			int lastQueued;
+			int lastApplied;
+		};
+	}
+}
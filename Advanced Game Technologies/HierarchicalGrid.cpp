@@ -0,0 +1,432 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Hierarchical pathfinding (HPA*) on top of a navigation grid.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "HierarchicalGrid.h"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cstdlib>
+using namespace NCL;
+using namespace CSC8503;
+
+const int CLUSTER_DX[4] = { 0, 0, -1, 1 };
+const int CLUSTER_DY[4] = { -1, 1, 0, 0 };
+
+// Openings narrower than this get one entrance in the middle, wider ones get one at each end.
+const int WIDE_ENTRANCE = 6;
+
+bool HierarchicalPath::NextSegment(NavigationPath& outPath)
+{
+	return owner && owner->RefineSegment(*this, outPath);
+}
+
+HierarchicalGrid::HierarchicalGrid(const NavigationGrid& grid, int clusterSize) : grid(grid)
+{
+	this->clusterSize = clusterSize;
+	clustersWide = (grid.GetWidth() + clusterSize - 1) / clusterSize;
+	clustersHigh = (grid.GetHeight() + clusterSize - 1) / clusterSize;
+
+	Rebuild();
+}
+
+void HierarchicalGrid::Rebuild()
+{
+	nodeCells.clear();
+	nodeClusters.clear();
+	edges.clear();
+	edgeCells.clear();
+	cellToNode.assign(grid.GetWidth() * grid.GetHeight(), -1);
+	clusterNodes.assign(clustersWide * clustersHigh, std::vector<int>());
+
+	BuildEntrances();
+	BuildIntraEdges();
+
+	builtRevision = grid.GetRevision();
+}
+
+int HierarchicalGrid::ClusterOf(int cell) const
+{
+	int x = cell % grid.GetWidth();
+	int y = cell / grid.GetWidth();
+	return (y / clusterSize) * clustersWide + (x / clusterSize);
+}
+
+int HierarchicalGrid::LocalIndex(int cluster, int cell) const
+{
+	int x = cell % grid.GetWidth() - (cluster % clustersWide) * clusterSize;
+	int y = cell / grid.GetWidth() - (cluster / clustersWide) * clusterSize;
+	return y * clusterSize + x;
+}
+
+int HierarchicalGrid::CellFromLocal(int cluster, int local) const
+{
+	int x = (cluster % clustersWide) * clusterSize + local % clusterSize;
+	int y = (cluster / clustersWide) * clusterSize + local / clusterSize;
+	return grid.CellIndex(x, y);
+}
+
+int HierarchicalGrid::AddNode(int cell)
+{
+	if (cellToNode[cell] >= 0)
+		return cellToNode[cell];
+
+	int node = (int)nodeCells.size();
+	int cluster = ClusterOf(cell);
+
+	nodeCells.emplace_back(cell);
+	nodeClusters.emplace_back(cluster);
+	cellToNode[cell] = node;
+	clusterNodes[cluster].emplace_back(node);
+	edges.emplace_back();
+	return node;
+}
+
+// A single step across a cluster border, both ways.
+void HierarchicalGrid::AddInterEdge(int fromCell, int toCell)
+{
+	int fromNode = AddNode(fromCell);
+	int toNode = AddNode(toCell);
+
+	edges[fromNode].push_back({ toNode, 1, true, (int)edgeCells.size(), 1 });
+	edgeCells.emplace_back(toCell);
+
+	edges[toNode].push_back({ fromNode, 1, true, (int)edgeCells.size(), 1 });
+	edgeCells.emplace_back(fromCell);
+}
+
+// Walk along the right and bottom border of every cluster, and put entrances on each run of cells that are open on both sides.
+void HierarchicalGrid::BuildEntrances()
+{
+	auto addRun = [this](int runStart, int runLength, bool vertical, int borderLine)
+	{
+		int positions[2] = { runStart + runLength / 2, -1 };
+		if (runLength >= WIDE_ENTRANCE)
+		{
+			positions[0] = runStart;
+			positions[1] = runStart + runLength - 1;
+		}
+
+		for (int p : positions)
+		{
+			if (p < 0)
+				continue;
+			if (vertical)
+				AddInterEdge(grid.CellIndex(borderLine, p), grid.CellIndex(borderLine + 1, p));
+			else
+				AddInterEdge(grid.CellIndex(p, borderLine), grid.CellIndex(p, borderLine + 1));
+		}
+	};
+
+	for (int cy = 0; cy < clustersHigh; ++cy)
+	{
+		for (int cx = 0; cx < clustersWide; ++cx)
+		{
+			// Border with the cluster to the right.
+			if (cx + 1 < clustersWide)
+			{
+				int x = (cx + 1) * clusterSize - 1;
+				int yEnd = std::min<int>((cy + 1) * clusterSize, grid.GetHeight());
+				int runStart = -1;
+
+				for (int y = cy * clusterSize; y <= yEnd; ++y)
+				{
+					bool open = y < yEnd && grid.IsWalkable(x, y) && grid.IsWalkable(x + 1, y);
+					if (open && runStart < 0)
+						runStart = y;
+					else if (!open && runStart >= 0)
+					{
+						addRun(runStart, y - runStart, true, x);
+						runStart = -1;
+					}
+				}
+			}
+
+			// Border with the cluster below.
+			if (cy + 1 < clustersHigh)
+			{
+				int y = (cy + 1) * clusterSize - 1;
+				int xEnd = std::min<int>((cx + 1) * clusterSize, grid.GetWidth());
+				int runStart = -1;
+
+				for (int x = cx * clusterSize; x <= xEnd; ++x)
+				{
+					bool open = x < xEnd && grid.IsWalkable(x, y) && grid.IsWalkable(x, y + 1);
+					if (open && runStart < 0)
+						runStart = x;
+					else if (!open && runStart >= 0)
+					{
+						addRun(runStart, x - runStart, false, y);
+						runStart = -1;
+					}
+				}
+			}
+		}
+	}
+}
+
+// Flood out from every entrance in a cluster and keep the path to each other entrance it reaches.
+void HierarchicalGrid::BuildIntraEdges()
+{
+	std::vector<int> distances;
+	std::vector<int> parents;
+	std::vector<int> frontier;
+
+	for (int cluster = 0; cluster < (int)clusterNodes.size(); ++cluster)
+	{
+		for (int from : clusterNodes[cluster])
+		{
+			FloodCluster(cluster, nodeCells[from], distances, parents, frontier);
+
+			for (int to : clusterNodes[cluster])
+			{
+				int distance = distances[LocalIndex(cluster, nodeCells[to])];
+				if (to == from || distance < 0)
+					continue;
+
+				int firstCell = (int)edgeCells.size();
+				TraceCluster(cluster, nodeCells[to], parents, edgeCells);
+				edges[from].push_back({ to, distance, false, firstCell, (int)edgeCells.size() - firstCell });
+			}
+		}
+	}
+}
+
+void HierarchicalGrid::FloodCluster(int cluster, int fromCell, std::vector<int>& distances, std::vector<int>& parents, std::vector<int>& frontier) const
+{
+	distances.assign(clusterSize * clusterSize, -1);
+	parents.assign(clusterSize * clusterSize, -1);
+	frontier.clear();
+
+	int minX = (cluster % clustersWide) * clusterSize;
+	int minY = (cluster / clustersWide) * clusterSize;
+	int maxX = std::min<int>(minX + clusterSize, grid.GetWidth());
+	int maxY = std::min<int>(minY + clusterSize, grid.GetHeight());
+
+	int start = LocalIndex(cluster, fromCell);
+	distances[start] = 0;
+	frontier.emplace_back(start);
+
+	for (size_t i = 0; i < frontier.size(); ++i)
+	{
+		int local = frontier[i];
+		int x = minX + local % clusterSize;
+		int y = minY + local / clusterSize;
+
+		for (int d = 0; d < 4; ++d)
+		{
+			int nx = x + CLUSTER_DX[d];
+			int ny = y + CLUSTER_DY[d];
+			if (nx < minX || ny < minY || nx >= maxX || ny >= maxY || !grid.IsWalkable(nx, ny))
+				continue;
+
+			int neighbour = (ny - minY) * clusterSize + (nx - minX);
+			if (distances[neighbour] >= 0)
+				continue;
+
+			distances[neighbour] = distances[local] + 1;
+			parents[neighbour] = local;
+			frontier.emplace_back(neighbour);
+		}
+	}
+}
+
+void HierarchicalGrid::TraceCluster(int cluster, int toCell, const std::vector<int>& parents, std::vector<int>& outCells) const
+{
+	size_t first = outCells.size();
+	for (int local = LocalIndex(cluster, toCell); parents[local] != -1; local = parents[local])
+		outCells.emplace_back(CellFromLocal(cluster, local));
+
+	std::reverse(outCells.begin() + first, outCells.end());
+}
+
+bool HierarchicalGrid::FindPath(const Vector3& from, const Vector3& to, HierarchicalPath& outPath, HierarchicalSearchContext& context) const
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	outPath.Clear();
+	context.lastStats.nodesExpanded = 0;
+
+	int fromX, fromY, toX, toY;
+	if (!grid.WorldToCell(from, fromX, fromY) || !grid.WorldToCell(to, toX, toY))
+		return false; // outside of map region!
+
+	if (!grid.IsWalkable(fromX, fromY) || !grid.IsWalkable(toX, toY))
+		return false;
+
+	int startCell = grid.CellIndex(fromX, fromY);
+	int goalCell = grid.CellIndex(toX, toY);
+	int startCluster = ClusterOf(startCell);
+	int goalCluster = ClusterOf(goalCell);
+
+	outPath.owner = this;
+	outPath.revision = builtRevision;
+	outPath.currentCell = startCell;
+
+	FloodCluster(startCluster, startCell, context.startDistances, context.startParents, context.frontier);
+
+	// Both ends in the same cluster and joined up inside it- no need to touch the abstract graph at all.
+	if (startCluster == goalCluster && context.startDistances[LocalIndex(startCluster, goalCell)] >= 0)
+	{
+		TraceCluster(startCluster, goalCell, context.startParents, outPath.explicitCells);
+		outPath.pieces.push_back({ true, false, 0, (int)outPath.explicitCells.size() });
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		context.lastStats.milliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+		return true;
+	}
+
+	FloodCluster(goalCluster, goalCell, context.goalDistances, context.goalParents, context.frontier);
+
+	// The start and goal are joined onto the graph on the fly: the start by seeding the open list with every entrance it can reach,
+	// the goal as one extra node on the end that entrances in its cluster can step to.
+	int nodeCount = (int)nodeCells.size();
+	int goalNode = nodeCount;
+
+	context.g.assign(nodeCount + 1, FLT_MAX);
+	context.parent.assign(nodeCount + 1, -1);
+	context.parentEdge.assign(nodeCount + 1, -1);
+	context.closed.assign(nodeCount + 1, 0);
+	context.open.Reset(nodeCount + 1);
+
+	auto heuristic = [this, goalCell](int node)
+	{
+		int cell = nodeCells[node];
+		return (float)(abs(cell % grid.GetWidth() - goalCell % grid.GetWidth()) + abs(cell / grid.GetWidth() - goalCell / grid.GetWidth()));
+	};
+
+	for (int node : clusterNodes[startCluster])
+	{
+		int distance = context.startDistances[LocalIndex(startCluster, nodeCells[node])];
+		if (distance < 0)
+			continue;
+
+		context.g[node] = (float)distance;
+		context.open.Push(node, distance + heuristic(node));
+	}
+
+	bool found = false;
+	while (!context.open.IsEmpty())
+	{
+		int current = context.open.Pop();
+		if (current == goalNode)
+		{
+			found = true;
+			break;
+		}
+
+		context.closed[current] = true;
+		context.lastStats.nodesExpanded++;
+
+		if (nodeClusters[current] == goalCluster)
+		{
+			int distance = context.goalDistances[LocalIndex(goalCluster, nodeCells[current])];
+			float g = context.g[current] + distance;
+			if (distance >= 0 && g < context.g[goalNode])
+			{
+				context.g[goalNode] = g;
+				context.parent[goalNode] = current;
+				if (context.open.Contains(goalNode))
+					context.open.DecreaseKey(goalNode, g);
+				else
+					context.open.Push(goalNode, g);
+			}
+		}
+
+		for (int i = 0; i < (int)edges[current].size(); ++i)
+		{
+			const Edge& edge = edges[current][i];
+			if (context.closed[edge.to])
+				continue;
+
+			float g = context.g[current] + edge.cost;
+			if (g >= context.g[edge.to])
+				continue;
+
+			context.g[edge.to] = g;
+			context.parent[edge.to] = current;
+			context.parentEdge[edge.to] = i;
+			if (context.open.Contains(edge.to))
+				context.open.DecreaseKey(edge.to, g + heuristic(edge.to));
+			else
+				context.open.Push(edge.to, g + heuristic(edge.to));
+		}
+	}
+	context.open.Clear();
+
+	if (found)
+	{
+		std::vector<int> route;
+		for (int node = context.parent[goalNode]; node != -1; node = context.parent[node])
+			route.emplace_back(node);
+		std::reverse(route.begin(), route.end());
+
+		// Start cell to the first entrance.
+		TraceCluster(startCluster, nodeCells[route.front()], context.startParents, outPath.explicitCells);
+		if (!outPath.explicitCells.empty())
+			outPath.pieces.push_back({ true, false, 0, (int)outPath.explicitCells.size() });
+
+		// Entrance to entrance, straight out of the precomputed edges.
+		for (size_t i = 1; i < route.size(); ++i)
+		{
+			const Edge& edge = edges[route[i - 1]][context.parentEdge[route[i]]];
+			outPath.pieces.push_back({ false, edge.crossesCluster, edge.firstCell, edge.cellCount });
+		}
+
+		// Last entrance to the goal. The goal flood's parents lead towards the goal, so walk them the other way.
+		std::vector<int> toGoal;
+		TraceCluster(goalCluster, nodeCells[route.back()], context.goalParents, toGoal);
+		if (!toGoal.empty())
+		{
+			int firstCell = (int)outPath.explicitCells.size();
+			for (int i = (int)toGoal.size() - 2; i >= 0; --i)
+				outPath.explicitCells.emplace_back(toGoal[i]);
+			outPath.explicitCells.emplace_back(goalCell);
+			outPath.pieces.push_back({ true, false, firstCell, (int)outPath.explicitCells.size() - firstCell });
+		}
+	}
+	else
+		outPath.Clear();
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	context.lastStats.milliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+
+	return found;
+}
+
+// Expand pieces until the route steps over into the next cluster- so only the stretch actually being walked is ever turned into waypoints.
+bool HierarchicalGrid::RefineSegment(HierarchicalPath& path, NavigationPath& outPath) const
+{
+	outPath.Clear();
+	if (path.revision != builtRevision)
+		path.Clear();
+
+	if (path.IsFinished())
+		return false;
+
+	std::vector<int> cells;
+	cells.emplace_back(path.currentCell);
+
+	while (!path.IsFinished())
+	{
+		const HierarchicalPath::Piece& piece = path.pieces[path.nextPiece++];
+		const std::vector<int>& source = piece.inRoute ? path.explicitCells : edgeCells;
+		cells.insert(cells.end(), source.begin() + piece.firstCell, source.begin() + piece.firstCell + piece.cellCount);
+
+		if (piece.crossesCluster)
+			break;
+	}
+	path.currentCell = cells.back();
+
+	// Pushed from the end back to the start, so popping waypoints gives them in walking order.
+	for (auto it = cells.rbegin(); it != cells.rend(); ++it)
+		outPath.PushWaypoint(grid.CellToWorld(*it % grid.GetWidth(), *it / grid.GetWidth()));
+
+	return true;
+}
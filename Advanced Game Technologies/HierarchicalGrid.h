@@ -0,0 +1,152 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Hierarchical pathfinding (HPA*) on top of a navigation grid.
+The grid is cut into square clusters, and at load time every opening between neighbouring clusters gets an entrance node,
+with the paths between entrances inside each cluster worked out once and kept.
+A query then only searches the small graph of entrances, and the route is turned back into grid cells a cluster at a time as it's walked.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "NavigationGrid.h"
+#include "IndexedHeap.h"
+#include <vector>
+
+namespace NCL {
+	namespace CSC8503 {
+		class HierarchicalGrid;
+
+		// A route through the entrance graph. Only expanded into actual waypoints one stretch at a time.
+		class HierarchicalPath
+		{
+		public:
+			HierarchicalPath() : owner(nullptr), revision(0), nextPiece(0), currentCell(-1) {}
+
+			void Clear()
+			{
+				owner = nullptr;
+				pieces.clear();
+				explicitCells.clear();
+				nextPiece = 0;
+				currentCell = -1;
+			}
+
+			bool IsFinished() const { return nextPiece >= pieces.size(); }
+
+			// Fill outPath with the waypoints up to and including the first step into the next cluster (or the goal).
+			// Starts with the cell the last stretch ended on, like a normal path starts with where you are.
+			bool NextSegment(NavigationPath& outPath);
+
+		protected:
+			friend class HierarchicalGrid;
+
+			// A run of cells, either stored in the route itself (the bits to and from the abstract graph) or a precomputed edge in the grid.
+			struct Piece
+			{
+				bool inRoute;
+				bool crossesCluster;
+				int firstCell;
+				int cellCount;
+			};
+
+			const HierarchicalGrid* owner;
+			// The grid revision this was planned at- once the grid changes the rest of the route can't be trusted.
+			int revision;
+			std::vector<Piece> pieces;
+			std::vector<int> explicitCells;
+			size_t nextPiece;
+			int currentCell;
+		};
+
+		// Per thread scratch for searching the entrance graph.
+		class HierarchicalSearchContext
+		{
+		public:
+			const NavigationSearchStats& GetLastStats() const { return lastStats; }
+
+		protected:
+			friend class HierarchicalGrid;
+
+			std::vector<float> g;
+			std::vector<int> parent;
+			std::vector<int> parentEdge;
+			std::vector<unsigned char> closed;
+			IndexedHeap<> open;
+
+			// Distances and parents for the flood inside the start and goal clusters, indexed by cell within the cluster.
+			std::vector<int> startDistances;
+			std::vector<int> startParents;
+			std::vector<int> goalDistances;
+			std::vector<int> goalParents;
+			std::vector<int> frontier;
+
+			NavigationSearchStats lastStats;
+		};
+
+		class HierarchicalGrid
+		{
+		public:
+			HierarchicalGrid(const NavigationGrid& grid, int clusterSize = 10);
+			~HierarchicalGrid() {}
+
+			// Redo the clusters after cells have changed. Any route planned before this just stops expanding, so it gets asked for again.
+			void Rebuild();
+			bool IsOutOfDate() const { return builtRevision != grid.GetRevision(); }
+
+			// Thread safe as long as every thread brings its own context.
+			bool FindPath(const Vector3& from, const Vector3& to, HierarchicalPath& outPath, HierarchicalSearchContext& context) const;
+
+			int GetClusterSize() const { return clusterSize; }
+			int GetNodeCount() const { return (int)nodeCells.size(); }
+			const NavigationGrid& GetGrid() const { return grid; }
+
+		protected:
+			friend class HierarchicalPath;
+
+			struct Edge
+			{
+				int to;
+				int cost;
+				bool crossesCluster;
+				int firstCell;
+				int cellCount;
+			};
+
+			int ClusterOf(int cell) const;
+			int AddNode(int cell);
+			void AddInterEdge(int fromCell, int toCell);
+			void BuildEntrances();
+			void BuildIntraEdges();
+
+			// Breadth first flood from a cell that never leaves its cluster. Distances are -1 where it couldn't get to.
+			void FloodCluster(int cluster, int fromCell, std::vector<int>& distances, std::vector<int>& parents, std::vector<int>& frontier) const;
+			// Walk back through a flood's parents: the cells after the flood's start up to and including toCell, in walking order.
+			void TraceCluster(int cluster, int toCell, const std::vector<int>& parents, std::vector<int>& outCells) const;
+
+			int LocalIndex(int cluster, int cell) const;
+			int CellFromLocal(int cluster, int local) const;
+
+			bool RefineSegment(HierarchicalPath& path, NavigationPath& outPath) const;
+
+			const NavigationGrid& grid;
+			int clusterSize;
+			int clustersWide;
+			int clustersHigh;
+			int builtRevision;
+
+			// Abstract nodes- one per entrance cell, with the cluster each belongs to.
+			std::vector<int> nodeCells;
+			std::vector<int> nodeClusters;
+			std::vector<int> cellToNode;
+			std::vector<std::vector<int>> clusterNodes;
+			std::vector<std::vector<Edge>> edges;
+
+			// Every precomputed path's cells, back to back. Edges point into this.
+			std::vector<int> edgeCells;
+		};
+	}
+}
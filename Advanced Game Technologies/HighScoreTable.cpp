@@ -0,0 +1,165 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A sorted, versioned high score table, sent to clients as just the rows they haven't seen.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "HighScoreTable.h"
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <random>
+using namespace NCL;
+using namespace CSC8503;
+
+HighScoreTable::HighScoreTable()
+{
+	tableID = 0;
+	Clear();
+}
+
+void HighScoreTable::Clear()
+{
+	count = 0;
+	version = 0;
+	for (int i = 0; i < MAX_HIGH_SCORES; ++i)
+	{
+		SetEntry(i, "", 0);
+		rowVersions[i] = 0;
+	}
+}
+
+void HighScoreTable::SetEntry(int rank, const char* name, int score)
+{
+	HighScoreEntry& entry = entries[rank];
+	entry.score = score;
+	strncpy(entry.name, name, MAX_HIGH_SCORE_NAME - 1);
+	entry.name[MAX_HIGH_SCORE_NAME - 1] = '\0';
+}
+
+bool HighScoreTable::Load(const std::string& filename)
+{
+	Clear();
+	// Never 0, so it can't match a client that's not been sent anything.
+	std::random_device random;
+	tableID = std::uniform_int_distribution<unsigned int>(1, 0xffffffff)(random);
+
+	std::ifstream infile(filename);
+	if (!infile)
+		return false;
+
+	std::string line;
+	while (getline(infile, line))
+	{
+		// The name can have spaces in, the score's whatever's after the last one.
+		size_t split = line.find_last_of(' ');
+		if (split == std::string::npos)
+			continue;
+		try
+		{
+			Submit(line.substr(0, split), std::stoi(line.substr(split + 1)));
+		}
+		catch (const std::exception&)
+		{
+			continue;
+		}
+	}
+
+	// However it was loaded, it's all the one version to a client.
+	version = count > 0 ? 1 : 0;
+	for (int i = 0; i < count; ++i)
+		rowVersions[i] = version;
+	return true;
+}
+
+bool HighScoreTable::Save(const std::string& filename) const
+{
+	std::ofstream outfile(filename);
+	if (!outfile)
+		return false;
+
+	for (int i = 0; i < count; ++i)
+		outfile << entries[i].name << " " << entries[i].score << "\n";
+	return true;
+}
+
+bool HighScoreTable::Submit(const std::string& name, int score)
+{
+	// Equal scores go below the ones already there.
+	int rank = 0;
+	while (rank < count && entries[rank].score >= score)
+		rank++;
+	if (rank >= MAX_HIGH_SCORES)
+		return false;
+
+	// Everything below moves down one, falling off the bottom if the table's full.
+	for (int i = std::min<int>(count, MAX_HIGH_SCORES - 1); i > rank; --i)
+		entries[i] = entries[i - 1];
+	SetEntry(rank, name.c_str(), score);
+	count = std::min<int>(count + 1, MAX_HIGH_SCORES);
+
+	version++;
+	for (int i = rank; i < count; ++i)
+		rowVersions[i] = version;
+	return true;
+}
+
+void HighScoreTable::WriteChanges(unsigned int knownTable, int knownVersion, HighScoreUpdatePacket& packet) const
+{
+	if (knownTable != tableID || knownVersion < 0 || knownVersion > version)
+		knownVersion = 0;
+
+	packet.tableID = tableID;
+	packet.version = version;
+	packet.baseVersion = knownVersion;
+	packet.count = count;
+
+	int changed = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		if (rowVersions[i] <= knownVersion)
+			continue;
+		packet.rows[changed].rank = i;
+		packet.rows[changed].entry = entries[i];
+		changed++;
+	}
+	packet.SetChangedCount(changed);
+}
+
+bool HighScoreTable::ReadChanges(const HighScoreUpdatePacket& packet)
+{
+	if (packet.changedCount < 0 || packet.changedCount > MAX_HIGH_SCORES || packet.count < 0 || packet.count > MAX_HIGH_SCORES)
+		return false;
+	if (packet.size < (int)(sizeof(int) * 5 + sizeof(HighScoreUpdatePacket::Row) * packet.changedCount))
+		return false;
+
+	// Changes from a version we haven't got yet would leave gaps, and older ones than ours are out of date already.
+	bool fullTable = packet.baseVersion == 0;
+	if (!fullTable && (packet.tableID != tableID || packet.baseVersion > version || packet.version < version))
+		return false;
+
+	for (int i = 0; i < packet.changedCount; ++i)
+	{
+		if (packet.rows[i].rank < 0 || packet.rows[i].rank >= packet.count)
+			return false;
+	}
+
+	if (fullTable)
+		Clear();
+
+	for (int i = 0; i < packet.changedCount; ++i)
+	{
+		const HighScoreUpdatePacket::Row& row = packet.rows[i];
+		SetEntry(row.rank, row.entry.name, row.entry.score);
+		rowVersions[row.rank] = packet.version;
+	}
+
+	count = packet.count;
+	version = packet.version;
+	tableID = packet.tableID;
+	return true;
+}
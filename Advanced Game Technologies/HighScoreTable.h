@@ -0,0 +1,129 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+The high score table, kept sorted in memory rather than read from file every time someone asks for it.
+The server loads it the once and saves it when a game ends. Every change bumps the table's version and stamps the rows it moved,
+so a client asking for the scores says which version it already has and only gets back the rows that have changed since-
+nothing but the version number if it's up to date. Clients keep the table they've been sent and just patch it.
+Versions start again from 1 every time the table's loaded, so each load also picks a random table ID- a client asking with a version
+from some other load of the table (the server's been restarted since) gets sent the whole thing, rather than patches that don't fit.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "../CSC8503Common/NetworkBase.h"
+#include "PacketDispatcher.h"
+#include <string>
+
+namespace NCL {
+	namespace CSC8503 {
+		const int MAX_HIGH_SCORES = 5;
+		const int MAX_HIGH_SCORE_NAME = 16;
+
+		struct HighScoreEntry
+		{
+			int score;
+			// Always null terminated.
+			char name[MAX_HIGH_SCORE_NAME];
+		};
+
+		// The client's way of asking for the scores- with what it's already got.
+		struct HighScoreRequestPacket : public GamePacket
+		{
+			unsigned int knownTable;
+			int knownVersion;
+
+			HighScoreRequestPacket(unsigned int knownTable, int knownVersion)
+			{
+				type = High_Score_Request;
+				size = sizeof(int) * 2;
+				this->knownTable = knownTable;
+				this->knownVersion = knownVersion;
+			}
+		};
+
+		struct HighScoreUpdatePacket : public GamePacket
+		{
+			struct Row
+			{
+				int rank;
+				HighScoreEntry entry;
+			};
+
+			unsigned int tableID;
+			int version;
+			// The version these changes are from- 0 means it's the whole table.
+			int baseVersion;
+			int count;
+			int changedCount;
+			Row rows[MAX_HIGH_SCORES];
+
+			HighScoreUpdatePacket()
+			{
+				type = High_Score_Update;
+				tableID = 0;
+				version = 0;
+				baseVersion = 0;
+				count = 0;
+				SetChangedCount(0);
+			}
+
+			// Only the rows that changed go over the wire.
+			void SetChangedCount(int changed)
+			{
+				changedCount = changed;
+				size = (short)(sizeof(int) * 5 + sizeof(Row) * changed);
+			}
+		};
+
+		template <>
+		struct PacketTraits<HighScoreRequestPacket> : public FixedSizePacketTraits<HighScoreRequestPacket, High_Score_Request> {};
+
+		template <>
+		struct PacketTraits<HighScoreUpdatePacket>
+		{
+			static const int Type = High_Score_Update;
+			static const int MinSize = sizeof(int) * 5;
+		};
+
+		class HighScoreTable
+		{
+		public:
+			HighScoreTable();
+			~HighScoreTable() {}
+
+			// One "name score" per line, best first. Gives the table a new ID, even if the file can't be read.
+			bool Load(const std::string& filename);
+			bool Save(const std::string& filename) const;
+
+			// Adds a score in its place- false if it didn't make the table.
+			bool Submit(const std::string& name, int score);
+
+			// Everything that's changed since knownVersion. A version from a different table ID, or one this table never had, gets the whole table.
+			void WriteChanges(unsigned int knownTable, int knownVersion, HighScoreUpdatePacket& packet) const;
+			// Client side- patches the cached table. False if the changes didn't apply to it.
+			bool ReadChanges(const HighScoreUpdatePacket& packet);
+
+			void Clear();
+
+			unsigned int GetTableID() const { return tableID; }
+			int GetVersion() const { return version; }
+			int GetCount() const { return count; }
+			const HighScoreEntry& GetEntry(int rank) const { return entries[rank]; }
+
+		protected:
+			void SetEntry(int rank, const char* name, int score);
+
+			HighScoreEntry entries[MAX_HIGH_SCORES];
+			// The version each row last changed in.
+			int rowVersions[MAX_HIGH_SCORES];
+			int count;
+			int version;
+			// 0 until it's been loaded (or sent a whole table to copy).
+			unsigned int tableID;
+		};
+	}
+}
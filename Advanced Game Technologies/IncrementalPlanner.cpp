@@ -0,0 +1,338 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+An incremental planner (LPA*, with the moving start handling from MT-D* Lite) for one agent chasing a moving target.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "IncrementalPlanner.h"
+#include <chrono>
+#include <cfloat>
+#include <cstdlib>
+using namespace NCL;
+using namespace CSC8503;
+
+const int PLANNER_DX[4] = { 0, 0, -1, 1 };
+const int PLANNER_DY[4] = { -1, 1, 0, 0 };
+
+const float UNREACHED = FLT_MAX;
+
+IncrementalPlanner::IncrementalPlanner(const NavigationGrid& grid) : grid(grid)
+{
+	root = -1;
+	goal = -1;
+	seenRevision = 0;
+	currentSearch = 0;
+	lastStats.nodesExpanded = 0;
+	lastStats.milliseconds = 0.0f;
+}
+
+bool IncrementalPlanner::FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	outPath.Clear();
+	lastStats.nodesExpanded = 0;
+
+	int fromX, fromY, toX, toY;
+	if (!grid.WorldToCell(from, fromX, fromY) || !grid.WorldToCell(to, toX, toY))
+		return false; // outside of map region!
+
+	if (!grid.IsWalkable(fromX, fromY) || !grid.IsWalkable(toX, toY))
+		return false;
+
+	int startCell = grid.CellIndex(fromX, fromY);
+	int goalCell = grid.CellIndex(toX, toY);
+	bool goalMoved = goalCell != goal;
+	goal = goalCell;
+
+	if (root < 0 || searchStamp.size() != (size_t)(grid.GetWidth() * grid.GetHeight()))
+		Reset(startCell);
+	else
+	{
+		ApplyGridChanges();
+
+		if (startCell != root)
+			Reroot(startCell);
+		// Costs from the root don't care where the goal is, only the heuristic part of the keys does.
+		else if (goalMoved)
+			RebuildOpenList();
+	}
+
+	ComputeShortestPath();
+
+	bool found = g[goal] != UNREACHED;
+	if (found)
+	{
+		// Pushed from the end back to the start, so popping waypoints gives them in walking order.
+		// Stepping to whichever neighbour is closest to the root always walks a shortest path back to it.
+		int cell = goal;
+		int width = grid.GetWidth();
+		for (size_t steps = 0; steps <= touchedCells.size(); ++steps)
+		{
+			outPath.PushWaypoint(grid.CellToWorld(cell % width, cell / width));
+			if (cell == root)
+				break;
+
+			int best = -1;
+			for (int d = 0; d < 4; ++d)
+			{
+				int nx = cell % width + PLANNER_DX[d];
+				int ny = cell / width + PLANNER_DY[d];
+				if (!grid.IsWalkable(nx, ny))
+					continue;
+
+				int neighbour = grid.CellIndex(nx, ny);
+				if (Touched(neighbour) && (best < 0 || g[neighbour] < g[best]))
+					best = neighbour;
+			}
+			cell = best;
+		}
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	lastStats.milliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+
+	return found;
+}
+
+void IncrementalPlanner::Reset(int newRoot)
+{
+	size_t cellCount = grid.GetWidth() * grid.GetHeight();
+	if (searchStamp.size() != cellCount)
+	{
+		searchStamp.assign(cellCount, 0);
+		g.resize(cellCount);
+		rhs.resize(cellCount);
+		parent.resize(cellCount);
+		inSubtree.resize(cellCount);
+		open.Reset(cellCount);
+		currentSearch = 0;
+	}
+	else
+	{
+		open.Clear();
+	}
+
+	// On the (very) rare wrap around, old stamps could look current again, so wipe them properly just that once.
+	currentSearch++;
+	if (currentSearch == 0)
+	{
+		searchStamp.assign(cellCount, 0);
+		currentSearch = 1;
+	}
+
+	touchedCells.clear();
+	seenRevision = grid.GetRevision();
+
+	root = newRoot;
+	Touch(root);
+	rhs[root] = 0;
+	open.Push(root, CalculateKey(root));
+}
+
+// Everything below the new root in the old search tree is still a shortest path from it, just shorter by however far along the root has moved.
+// Everything else is forgotten and rebuilt off the edge of what was kept.
+void IncrementalPlanner::Reroot(int newRoot)
+{
+	if (!Touched(newRoot) || g[newRoot] == UNREACHED || g[newRoot] != rhs[newRoot])
+	{
+		Reset(newRoot);
+		return;
+	}
+
+	for (int cell : touchedCells)
+		inSubtree[cell] = -1;
+
+	// Walk up the tree from every cell until hitting one that's already been decided, then mark the whole way back down the same.
+	for (int cell : touchedCells)
+	{
+		chain.clear();
+		int current = cell;
+		signed char result;
+
+		while (true)
+		{
+			if (inSubtree[current] != -1)
+			{
+				result = inSubtree[current];
+				break;
+			}
+			if (current == newRoot)
+			{
+				result = 1;
+				break;
+			}
+			// Only follow links through cells the search has finished with- anything still open can't be trusted.
+			if (parent[current] == -1 || g[current] == UNREACHED || g[current] != rhs[current])
+			{
+				result = 0;
+				break;
+			}
+			chain.emplace_back(current);
+			current = parent[current];
+		}
+
+		inSubtree[current] = result;
+		for (int link : chain)
+			inSubtree[link] = result;
+	}
+
+	float offset = g[newRoot];
+	for (int cell : touchedCells)
+	{
+		if (inSubtree[cell] == 1)
+		{
+			g[cell] -= offset;
+			rhs[cell] -= offset;
+		}
+		else
+		{
+			g[cell] = UNREACHED;
+			rhs[cell] = UNREACHED;
+			parent[cell] = -1;
+		}
+	}
+
+	root = newRoot;
+	parent[root] = -1;
+
+	for (int cell : touchedCells)
+	{
+		if (inSubtree[cell] != 1)
+			UpdateRhs(cell);
+	}
+	RebuildOpenList();
+}
+
+void IncrementalPlanner::ApplyGridChanges()
+{
+	int width = grid.GetWidth();
+	for (; seenRevision < grid.GetRevision(); ++seenRevision)
+	{
+		int cell = grid.GetChangedCell(seenRevision);
+		UpdateCell(cell);
+
+		for (int d = 0; d < 4; ++d)
+		{
+			int nx = cell % width + PLANNER_DX[d];
+			int ny = cell / width + PLANNER_DY[d];
+			if (grid.IsWalkable(nx, ny))
+				UpdateCell(grid.CellIndex(nx, ny));
+		}
+	}
+}
+
+void IncrementalPlanner::RebuildOpenList()
+{
+	open.Clear();
+	for (int cell : touchedCells)
+	{
+		if (g[cell] != rhs[cell])
+			open.Push(cell, CalculateKey(cell));
+	}
+}
+
+void IncrementalPlanner::Touch(int cell)
+{
+	if (Touched(cell))
+		return;
+
+	searchStamp[cell] = currentSearch;
+	g[cell] = UNREACHED;
+	rhs[cell] = UNREACHED;
+	parent[cell] = -1;
+	touchedCells.emplace_back(cell);
+}
+
+// The best a cell could do going through any of its neighbours, as things stand.
+void IncrementalPlanner::UpdateRhs(int cell)
+{
+	Touch(cell);
+	if (cell == root)
+		return;
+
+	rhs[cell] = UNREACHED;
+	parent[cell] = -1;
+
+	int width = grid.GetWidth();
+	int x = cell % width;
+	int y = cell / width;
+	if (!grid.IsWalkable(x, y))
+		return;
+
+	for (int d = 0; d < 4; ++d)
+	{
+		int nx = x + PLANNER_DX[d];
+		int ny = y + PLANNER_DY[d];
+		if (!grid.IsWalkable(nx, ny))
+			continue;
+
+		int neighbour = grid.CellIndex(nx, ny);
+		if (!Touched(neighbour) || g[neighbour] == UNREACHED)
+			continue;
+
+		if (g[neighbour] + 1 < rhs[cell])
+		{
+			rhs[cell] = g[neighbour] + 1;
+			parent[cell] = neighbour;
+		}
+	}
+}
+
+void IncrementalPlanner::UpdateCell(int cell)
+{
+	UpdateRhs(cell);
+
+	if (open.Contains(cell))
+		open.Remove(cell);
+	if (g[cell] != rhs[cell])
+		open.Push(cell, CalculateKey(cell));
+}
+
+void IncrementalPlanner::ComputeShortestPath()
+{
+	Touch(goal);
+	int width = grid.GetWidth();
+
+	while (!open.IsEmpty() && (open.TopKey() < CalculateKey(goal) || rhs[goal] != g[goal]))
+	{
+		int cell = open.Pop();
+		lastStats.nodesExpanded++;
+
+		// Found a better cost than before- settle on it. Otherwise the old cost's gone up, so drop it and work it out again.
+		if (g[cell] > rhs[cell])
+			g[cell] = rhs[cell];
+		else
+		{
+			g[cell] = UNREACHED;
+			UpdateCell(cell);
+		}
+
+		for (int d = 0; d < 4; ++d)
+		{
+			int nx = cell % width + PLANNER_DX[d];
+			int ny = cell / width + PLANNER_DY[d];
+			if (grid.IsWalkable(nx, ny))
+				UpdateCell(grid.CellIndex(nx, ny));
+		}
+	}
+}
+
+PlannerKey IncrementalPlanner::CalculateKey(int cell) const
+{
+	float best = g[cell] < rhs[cell] ? g[cell] : rhs[cell];
+	if (best == UNREACHED)
+		return { UNREACHED, UNREACHED };
+	return { best + Heuristic(cell), best };
+}
+
+// Manhattan distance to the goal, same as the grid's own A*.
+float IncrementalPlanner::Heuristic(int cell) const
+{
+	int width = grid.GetWidth();
+	return (float)(abs(cell % width - goal % width) + abs(cell / width - goal / width));
+}
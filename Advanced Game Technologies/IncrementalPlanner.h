@@ -0,0 +1,85 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+An incremental planner (LPA*, with the moving start handling from MT-D* Lite) for one agent chasing a moving target.
+Keeps its search between calls, so when the target moves a cell or two, the agent walks along the path, or a gate opens,
+only the part of the search that's actually affected gets redone instead of starting from scratch.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "NavigationGrid.h"
+#include "IndexedHeap.h"
+#include <vector>
+
+namespace NCL {
+	namespace CSC8503 {
+		// LPA* orders its open list on two numbers, the second only breaking ties in the first.
+		struct PlannerKey
+		{
+			float primary;
+			float secondary;
+
+			bool operator<(const PlannerKey& other) const
+			{
+				return primary < other.primary || (primary == other.primary && secondary < other.secondary);
+			}
+			bool operator<=(const PlannerKey& other) const { return !(other < *this); }
+		};
+
+		class IncrementalPlanner
+		{
+		public:
+			IncrementalPlanner(const NavigationGrid& grid);
+			~IncrementalPlanner() {}
+
+			// Same as NavigationGrid::FindPath, but reusing whatever it can of the last call's search.
+			bool FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath);
+
+			const NavigationSearchStats& GetLastStats() const { return lastStats; }
+
+		protected:
+			// Throw the whole search away and start again from a new cell.
+			void Reset(int newRoot);
+			// Move the root to somewhere already in the search tree, keeping everything that hangs off it.
+			void Reroot(int newRoot);
+			void ApplyGridChanges();
+			void RebuildOpenList();
+
+			bool Touched(int cell) const { return searchStamp[cell] == currentSearch; }
+			void Touch(int cell);
+
+			void UpdateRhs(int cell);
+			void UpdateCell(int cell);
+			void ComputeShortestPath();
+
+			PlannerKey CalculateKey(int cell) const;
+			float Heuristic(int cell) const;
+
+			const NavigationGrid& grid;
+			int root;
+			int goal;
+			int seenRevision;
+
+			// Cost from the root as of the last time each cell was expanded (g), and what its neighbours say it should be now (rhs).
+			// Cells where those disagree are the ones left to fix, and sit in the open list.
+			std::vector<unsigned int> searchStamp;
+			std::vector<float> g;
+			std::vector<float> rhs;
+			std::vector<int> parent;
+			std::vector<int> touchedCells;
+			unsigned int currentSearch;
+
+			IndexedHeap<PlannerKey> open;
+
+			// Scratch for Reroot: whether each touched cell hangs off the new root (1), doesn't (0), or isn't known yet (-1).
+			std::vector<signed char> inSubtree;
+			std::vector<int> chain;
+
+			NavigationSearchStats lastStats;
+		};
+	}
+}
@@ -0,0 +1,151 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A d-ary min heap of node indices that remembers where every node sits in it,
+so a node already in the open list can have its cost lowered in place instead of being searched for.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include <vector>
+
+namespace NCL {
+	namespace CSC8503 {
+		// Keys just need < and <=, so searches that order on more than one number can bring their own key type.
+		template <typename Key = float>
+		class IndexedHeap
+		{
+		public:
+			// Four children per parent: a shallower tree than binary, and the children sit next to each other in memory.
+			static const int ARITY = 4;
+
+			// Size the position lookup for a graph. Only needs doing again if the node count changes.
+			void Reset(size_t nodeCount)
+			{
+				heap.clear();
+				keys.clear();
+				positions.assign(nodeCount, -1);
+			}
+
+			// Empty the heap between searches- only touches the nodes that were still in it, not the whole graph.
+			void Clear()
+			{
+				for (int node : heap)
+					positions[node] = -1;
+				heap.clear();
+				keys.clear();
+			}
+
+			bool IsEmpty() const { return heap.empty(); }
+			bool Contains(int node) const { return positions[node] >= 0; }
+			size_t Size() const { return heap.size(); }
+
+			int Top() const { return heap[0]; }
+			const Key& TopKey() const { return keys[0]; }
+
+			void Push(int node, const Key& key)
+			{
+				heap.emplace_back(node);
+				keys.emplace_back(key);
+				positions[node] = (int)heap.size() - 1;
+				SiftUp(heap.size() - 1);
+			}
+
+			// Only ever lowers- A* never needs a node's cost to go up while it's open.
+			void DecreaseKey(int node, const Key& key)
+			{
+				size_t i = positions[node];
+				keys[i] = key;
+				SiftUp(i);
+			}
+
+			int Pop()
+			{
+				int top = heap[0];
+				positions[top] = -1;
+
+				heap[0] = heap.back();
+				keys[0] = keys.back();
+				heap.pop_back();
+				keys.pop_back();
+
+				if (!heap.empty())
+				{
+					positions[heap[0]] = 0;
+					SiftDown(0);
+				}
+				return top;
+			}
+
+			// Take a node out from wherever it is- for searches that need to raise a key, or drop a node that's no longer open.
+			void Remove(int node)
+			{
+				size_t i = positions[node];
+				size_t last = heap.size() - 1;
+				if (i != last)
+					Swap(i, last);
+
+				heap.pop_back();
+				keys.pop_back();
+				positions[node] = -1;
+
+				if (i < heap.size())
+				{
+					SiftUp(i);
+					SiftDown(i);
+				}
+			}
+
+		protected:
+			void Swap(size_t a, size_t b)
+			{
+				std::swap(heap[a], heap[b]);
+				std::swap(keys[a], keys[b]);
+				positions[heap[a]] = (int)a;
+				positions[heap[b]] = (int)b;
+			}
+
+			void SiftUp(size_t i)
+			{
+				while (i > 0)
+				{
+					size_t parent = (i - 1) / ARITY;
+					if (keys[parent] <= keys[i])
+						break;
+					Swap(i, parent);
+					i = parent;
+				}
+			}
+
+			void SiftDown(size_t i)
+			{
+				while (true)
+				{
+					size_t first = i * ARITY + 1;
+					if (first >= heap.size())
+						break;
+
+					size_t last = first + ARITY < heap.size() ? first + ARITY : heap.size();
+					size_t best = first;
+					for (size_t c = first + 1; c < last; ++c)
+					{
+						if (keys[c] < keys[best])
+							best = c;
+					}
+
+					if (keys[i] <= keys[best])
+						break;
+					Swap(i, best);
+					i = best;
+				}
+			}
+
+			std::vector<int> heap;
+			std::vector<Key> keys;
+			std::vector<int> positions;
+		};
+	}
+}
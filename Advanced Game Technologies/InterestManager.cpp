@@ -0,0 +1,65 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Per-client relevance for the snapshots, answered from a grid around each client's goose.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "InterestManager.h"
+#include "../CSC8503Common/GameObject.h"
+using namespace NCL;
+using namespace CSC8503;
+
+// How much further out than the radius something already relevant has to get before it's dropped.
+const float LEAVE_MARGIN = 1.25f;
+
+InterestManager::InterestManager(float radius) : grid(radius / 2)
+{
+	enterRadius = radius;
+	leaveRadius = radius * LEAVE_MARGIN;
+}
+
+void InterestManager::AddObject(GameObject* object)
+{
+	objects.emplace_back(object);
+	// A cleared grid hands out handles in order, so each object's handle is its index.
+	grid.Add(object->GetTransform().GetWorldPosition());
+}
+
+void InterestManager::Clear()
+{
+	objects.clear();
+	grid.Clear();
+}
+
+void InterestManager::Update()
+{
+	for (size_t i = 0; i < objects.size(); ++i)
+		grid.Move((int)i, objects[i]->GetTransform().GetWorldPosition());
+}
+
+void InterestManager::UpdateRelevance(const Vector3& position, std::vector<bool>& relevant) const
+{
+	if (relevant.size() != objects.size())
+		relevant.assign(objects.size(), false);
+	// Built up in a spare and swapped in, so nothing's allocated per client once it's all warmed up.
+	updated.assign(objects.size(), false);
+
+	float enterSq = enterRadius * enterRadius;
+	grid.QueryRadius(position, leaveRadius, nearby);
+	for (int handle : nearby)
+	{
+		if (relevant[handle])
+		{
+			updated[handle] = true;
+			continue;
+		}
+
+		Vector3 offset = objects[handle]->GetTransform().GetWorldPosition() - position;
+		updated[handle] = offset.x * offset.x + offset.z * offset.z <= enterSq;
+	}
+	relevant.swap(updated);
+}
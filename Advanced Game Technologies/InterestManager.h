@@ -0,0 +1,49 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Working out which networked objects each client actually needs to hear about. Everything the server replicates sits in a spatial grid
+over the ground plane, moved (not rebuilt) each snapshot, and each client's interest is whatever's within a radius of its goose- so
+finding it only looks at the cells around the goose, not every object. Objects already relevant to a client stay so a little further out
+than new ones come in, so something sat right on the edge doesn't keep flickering in and out.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "../CSC8503Common/SpatialHash.h"
+#include <vector>
+
+namespace NCL {
+	namespace CSC8503 {
+		class GameObject;
+
+		class InterestManager
+		{
+		public:
+			InterestManager(float radius = 60.0f);
+			~InterestManager() {}
+
+			// Has to be the same order the snapshots use, so the indices line up.
+			void AddObject(GameObject* object);
+			void Clear();
+
+			// Once per snapshot, before any client's interest is worked out.
+			void Update();
+
+			// Fills relevant (indexed like the snapshot's objects) for a client centred on position. Keeps whatever was relevant before to decide what stays.
+			void UpdateRelevance(const Vector3& position, std::vector<bool>& relevant) const;
+
+		protected:
+			std::vector<GameObject*> objects;
+			SpatialHash grid;
+
+			float enterRadius;
+			float leaveRadius;
+
+			mutable std::vector<int> nearby;
+			mutable std::vector<bool> updated;
+		};
+	}
+}
@@ -0,0 +1,79 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+In-process datagrams between a server and its clients, with simulated latency, jitter and loss.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "LoopbackTransport.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+using namespace NCL;
+using namespace CSC8503;
+
+LoopbackTransport::LoopbackTransport(float latency, float jitter, float lossRate, unsigned int seed) : random(seed)
+{
+	this->latency = latency;
+	this->jitter = jitter;
+	this->lossRate = lossRate;
+	time = 0.0f;
+	nextOrder = 0;
+}
+
+int LoopbackTransport::AddEndpoint(PacketReceiver* receiver)
+{
+	Endpoint endpoint;
+	endpoint.receiver = receiver;
+	endpoint.bytesSent = 0;
+	endpoint.bytesReceived = 0;
+	endpoint.packetsSent = 0;
+	endpoints.emplace_back(endpoint);
+	return (int)endpoints.size() - 1;
+}
+
+void LoopbackTransport::Send(int from, int to, const GamePacket& packet)
+{
+	int size = (int)sizeof(GamePacket) + packet.size;
+	endpoints[from].bytesSent += size;
+	endpoints[from].packetsSent++;
+
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	if (unit(random) < lossRate)
+		return;
+
+	Datagram datagram;
+	datagram.arrival = time + latency + jitter * unit(random);
+	datagram.order = nextOrder++;
+	datagram.from = from;
+	datagram.data.resize((size + sizeof(long long) - 1) / sizeof(long long));
+	memcpy(datagram.data.data(), &packet, size);
+	endpoints[to].inbox.emplace_back(std::move(datagram));
+}
+
+int LoopbackTransport::Poll(int endpoint)
+{
+	Endpoint& target = endpoints[endpoint];
+
+	// Taken out of the inbox before any are handed over, in case handling one sends another.
+	arrived.clear();
+	auto due = std::partition(target.inbox.begin(), target.inbox.end(), [this](const Datagram& datagram) { return datagram.arrival > time; });
+	std::move(due, target.inbox.end(), std::back_inserter(arrived));
+	target.inbox.erase(due, target.inbox.end());
+
+	std::sort(arrived.begin(), arrived.end(), [](const Datagram& a, const Datagram& b)
+	{
+		return a.arrival != b.arrival ? a.arrival < b.arrival : a.order < b.order;
+	});
+
+	for (Datagram& datagram : arrived)
+	{
+		GamePacket* packet = (GamePacket*)datagram.data.data();
+		target.bytesReceived += (int)sizeof(GamePacket) + packet->size;
+		target.receiver->ReceivePacket(packet->type, packet, datagram.from);
+	}
+	return (int)arrived.size();
+}
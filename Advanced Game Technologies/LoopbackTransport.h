@@ -0,0 +1,73 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+An in-process stand-in for the network, for running a server and any number of clients in one program without any sockets.
+Each end registers the receiver its packets should go to and gets back an address to be sent to by- the server's packets arrive
+tagged with the sender's address, the same as a peer ID from the real server. Datagrams can be held back (with jitter, so they
+reorder), or dropped, like real ones, and nothing's handed over until the receiving end polls for it, like the framework's
+UpdateServer/UpdateClient.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "../CSC8503Common/NetworkBase.h"
+#include <random>
+#include <vector>
+
+namespace NCL {
+	namespace CSC8503 {
+		class LoopbackTransport
+		{
+		public:
+			// Latency and jitter in seconds, loss between 0 and 1.
+			LoopbackTransport(float latency = 0.0f, float jitter = 0.0f, float lossRate = 0.0f, unsigned int seed = 1);
+			~LoopbackTransport() {}
+
+			int AddEndpoint(PacketReceiver* receiver);
+
+			void Send(int from, int to, const GamePacket& packet);
+
+			void Update(float dt) { time += dt; }
+			// Hands everything that's arrived for this end by now to its receiver, oldest first. Returns how many.
+			int Poll(int endpoint);
+
+			float GetTime() const { return time; }
+			long long GetBytesSent(int endpoint) const { return endpoints[endpoint].bytesSent; }
+			long long GetBytesReceived(int endpoint) const { return endpoints[endpoint].bytesReceived; }
+			int GetPacketsSent(int endpoint) const { return endpoints[endpoint].packetsSent; }
+
+		protected:
+			struct Datagram
+			{
+				float arrival;
+				// Breaks ties between datagrams due at the same time, so they come out in the order they went in.
+				long long order;
+				int from;
+				// Kept in something 8 byte aligned, so the receiver can read packet fields straight out of it.
+				std::vector<long long> data;
+			};
+
+			struct Endpoint
+			{
+				PacketReceiver* receiver;
+				std::vector<Datagram> inbox;
+				long long bytesSent;
+				long long bytesReceived;
+				int packetsSent;
+			};
+
+			std::vector<Endpoint> endpoints;
+			std::vector<Datagram> arrived;
+
+			float time;
+			float latency;
+			float jitter;
+			float lossRate;
+			long long nextOrder;
+			std::mt19937 random;
+		};
+	}
+}
@@ -0,0 +1,432 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A navigation grid loaded from a level file, searched with A* over flat arrays.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "NavigationGrid.h"
+#include "../../Common/Assets.h"
+#include <fstream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+using namespace NCL;
+using namespace CSC8503;
+
+// Neighbour order matches the framework grid: up, down, left, right.
+const int NEIGHBOUR_DX[4] = { 0, 0, -1, 1 };
+const int NEIGHBOUR_DY[4] = { -1, 1, 0, 0 };
+
+void NavigationSearchContext::Begin(size_t nodeCount)
+{
+	if (searchStamp.size() != nodeCount)
+	{
+		searchStamp.assign(nodeCount, 0);
+		g.resize(nodeCount);
+		parent.resize(nodeCount);
+		closed.resize(nodeCount);
+		arrival.resize(nodeCount);
+		open.Reset(nodeCount);
+		currentSearch = 0;
+	}
+	else
+	{
+		open.Clear();
+	}
+
+	// On the (very) rare wrap around, old stamps could look current again, so wipe them properly just that once.
+	currentSearch++;
+	if (currentSearch == 0)
+	{
+		searchStamp.assign(nodeCount, 0);
+		currentSearch = 1;
+	}
+
+	lastStats.nodesExpanded = 0;
+	lastStats.milliseconds = 0.0f;
+}
+
+NavigationGrid::NavigationGrid()
+{
+	nodeSize = 0;
+	gridWidth = 0;
+	gridHeight = 0;
+	searchMode = ASTAR;
+}
+
+NavigationGrid::NavigationGrid(const std::string& filename, const Vector3& offset) : NavigationGrid()
+{
+	this->offset = offset;
+
+	std::ifstream infile(Assets::DATADIR + filename);
+
+	infile >> nodeSize;
+	infile >> gridWidth;
+	infile >> gridHeight;
+
+	cellTypes.resize(gridWidth * gridHeight);
+	walkable.resize(gridWidth * gridHeight);
+
+	for (int y = 0; y < gridHeight; ++y)
+	{
+		for (int x = 0; x < gridWidth; ++x)
+		{
+			char type = 0;
+			infile >> type;
+			cellTypes[CellIndex(x, y)] = type;
+			walkable[CellIndex(x, y)] = !IsBlockedType(type);
+		}
+	}
+
+	BuildNeighbours();
+	BuildJumpTables();
+}
+
+NavigationGrid::~NavigationGrid()
+{
+}
+
+void NavigationGrid::SetWalkable(int x, int y, bool canWalk)
+{
+	if (x < 0 || y < 0 || x >= gridWidth || y >= gridHeight || (bool)walkable[CellIndex(x, y)] == canWalk)
+		return;
+
+	walkable[CellIndex(x, y)] = canWalk;
+	changedCells.emplace_back(CellIndex(x, y));
+
+	// Gates don't change often, and both of these are cheap next to loading a level, so just redo them whole.
+	BuildNeighbours();
+	BuildJumpTables();
+}
+
+// Work out once which directions each cell can move in, so the search never has to bounds check or look at cell types.
+void NavigationGrid::BuildNeighbours()
+{
+	for (int d = 0; d < 4; ++d)
+		neighbourOffsets[d] = NEIGHBOUR_DY[d] * gridWidth + NEIGHBOUR_DX[d];
+
+	neighbourMask.assign(gridWidth * gridHeight, 0);
+
+	for (int y = 0; y < gridHeight; ++y)
+	{
+		for (int x = 0; x < gridWidth; ++x)
+		{
+			if (!walkable[CellIndex(x, y)])
+				continue;
+
+			for (int d = 0; d < 4; ++d)
+			{
+				if (IsWalkable(x + NEIGHBOUR_DX[d], y + NEIGHBOUR_DY[d]))
+					neighbourMask[CellIndex(x, y)] |= (1 << d);
+			}
+		}
+	}
+}
+
+bool NavigationGrid::WorldToCell(const Vector3& position, int& x, int& y) const
+{
+	if (nodeSize <= 0)
+		return false;
+
+	// Level objects sit exactly on node positions, so round to the nearest rather than truncating.
+	x = (int)floorf((position.x - offset.x) / nodeSize + 0.5f);
+	y = (int)floorf((position.z - offset.z) / nodeSize + 0.5f);
+
+	return x >= 0 && y >= 0 && x < gridWidth && y < gridHeight;
+}
+
+Vector3 NavigationGrid::CellToWorld(int x, int y) const
+{
+	return Vector3((float)(x * nodeSize), 0, (float)(y * nodeSize)) + offset;
+}
+
+// Manhattan distance- exact on an open four-connected grid, so it never overestimates.
+float NavigationGrid::Heuristic(int from, int to) const
+{
+	int dx = abs((from % gridWidth) - (to % gridWidth));
+	int dy = abs((from / gridWidth) - (to / gridWidth));
+	return (float)(dx + dy);
+}
+
+bool NavigationGrid::FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath)
+{
+	return FindPath(from, to, outPath, defaultContext);
+}
+
+bool NavigationGrid::FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath, NavigationSearchContext& context) const
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	outPath.Clear();
+	context.Begin(walkable.size());
+
+	int fromX, fromY, toX, toY;
+	if (!WorldToCell(from, fromX, fromY) || !WorldToCell(to, toX, toY))
+		return false; // outside of map region!
+
+	int startNode = CellIndex(fromX, fromY);
+	int endNode = CellIndex(toX, toY);
+
+	if (!walkable[startNode] || !walkable[endNode])
+		return false;
+
+	context.searchStamp[startNode] = context.currentSearch;
+	context.g[startNode] = 0;
+	context.parent[startNode] = -1;
+	context.closed[startNode] = false;
+	context.arrival[startNode] = -1;
+	context.open.Push(startNode, Heuristic(startNode, endNode));
+
+	bool found = searchMode == JUMP_POINT ? FindPathJumpPoint(endNode, context) : FindPathAStar(endNode, context);
+
+	if (found)
+	{
+		// Pushed from the end back to the start, so popping waypoints gives them in walking order.
+		// Jump points can be several cells apart, so fill in every cell along the straight line between them too.
+		for (int node = endNode; node != -1; node = context.parent[node])
+		{
+			int x = node % gridWidth;
+			int y = node / gridWidth;
+			outPath.PushWaypoint(CellToWorld(x, y));
+
+			int parent = context.parent[node];
+			if (parent == -1)
+				break;
+
+			int px = parent % gridWidth;
+			int py = parent / gridWidth;
+			int stepX = (px > x) - (px < x);
+			int stepY = (py > y) - (py < y);
+
+			for (x += stepX, y += stepY; x != px || y != py; x += stepX, y += stepY)
+				outPath.PushWaypoint(CellToWorld(x, y));
+		}
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	context.lastStats.milliseconds = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+
+	return found;
+}
+
+void NavigationGrid::RelaxNode(NavigationSearchContext& context, int current, int neighbour, float distance, int dir, int endNode) const
+{
+	float g = context.g[current] + distance;
+
+	// First time this search has seen the node- whatever was in its slots belongs to an older search.
+	if (!context.Touched(neighbour))
+	{
+		context.searchStamp[neighbour] = context.currentSearch;
+		context.g[neighbour] = g;
+		context.parent[neighbour] = current;
+		context.closed[neighbour] = false;
+		context.arrival[neighbour] = dir;
+		context.open.Push(neighbour, g + Heuristic(neighbour, endNode));
+		return;
+	}
+
+	// Consistent heuristic, so anything closed already has its best cost.
+	if (context.closed[neighbour] || g >= context.g[neighbour])
+		return;
+
+	context.g[neighbour] = g;
+	context.parent[neighbour] = current;
+	context.arrival[neighbour] = dir;
+	context.open.DecreaseKey(neighbour, g + Heuristic(neighbour, endNode));
+}
+
+bool NavigationGrid::FindPathAStar(int endNode, NavigationSearchContext& context) const
+{
+	while (!context.open.IsEmpty())
+	{
+		int current = context.open.Pop();
+		context.closed[current] = true;
+		context.lastStats.nodesExpanded++;
+
+		if (current == endNode)
+			return true;
+
+		unsigned char mask = neighbourMask[current];
+		for (int d = 0; d < 4; ++d)
+		{
+			if (mask & (1 << d))
+				RelaxNode(context, current, current + neighbourOffsets[d], 1.0f, d, endNode);
+		}
+	}
+	return false;
+}
+
+/* JUMP POINT SEARCH */
+
+/*
+Jump point search on a four-connected grid. Paths are kept canonical by only ever turning from vertical to horizontal freely:
+- Moving vertically, the search can carry on or turn either way horizontally.
+- Moving horizontally, it can only carry on, unless a cell above or below opens up that was blocked behind it (a forced neighbour).
+- Vertical jumps stop wherever a horizontal jump from that cell would find something, so nothing reachable gets skipped over.
+Jump distances ignore the goal, so they're worked out once at load and the goal is checked for on the fly.
+*/
+
+bool NavigationGrid::IsForced(int x, int y, int horizontalDir, int verticalDir) const
+{
+	int behindX = x - NEIGHBOUR_DX[horizontalDir];
+	int sideY = y + NEIGHBOUR_DY[verticalDir];
+	return IsWalkable(x, sideY) && !IsWalkable(behindX, sideY);
+}
+
+bool NavigationGrid::IsCanonicalDirection(int node, int arrivedDir, int dir) const
+{
+	// The start can go anywhere.
+	if (arrivedDir < 0)
+		return true;
+
+	if (dir == arrivedDir)
+		return true;
+
+	bool arrivedVertically = arrivedDir < 2;
+	bool turningVertically = dir < 2;
+
+	// Never straight back the way we came.
+	if (arrivedVertically == turningVertically)
+		return false;
+
+	if (arrivedVertically)
+		return true;
+
+	return IsForced(node % gridWidth, node / gridWidth, arrivedDir, dir);
+}
+
+void NavigationGrid::BuildJumpTables()
+{
+	int count = gridWidth * gridHeight;
+	jumpDistances.assign(count * 4, 0);
+	wallDistances.assign(count * 4, 0);
+
+	// Each direction is filled in by sweeping against it, so the next cell along has always been done already.
+	auto sweep = [&](int dir, bool (NavigationGrid::*isJumpPoint)(int, int, int) const) {
+		bool reverseX = NEIGHBOUR_DX[dir] > 0;
+		bool reverseY = NEIGHBOUR_DY[dir] > 0;
+
+		for (int j = 0; j < gridHeight; ++j)
+		{
+			int y = reverseY ? gridHeight - 1 - j : j;
+			for (int i = 0; i < gridWidth; ++i)
+			{
+				int x = reverseX ? gridWidth - 1 - i : i;
+				if (!walkable[CellIndex(x, y)])
+					continue;
+
+				int nx = x + NEIGHBOUR_DX[dir];
+				int ny = y + NEIGHBOUR_DY[dir];
+				int slot = CellIndex(x, y) * 4 + dir;
+
+				if (!IsWalkable(nx, ny))
+				{
+					jumpDistances[slot] = 0;
+					wallDistances[slot] = 0;
+					continue;
+				}
+
+				int next = CellIndex(nx, ny) * 4 + dir;
+				wallDistances[slot] = wallDistances[next] + 1;
+
+				if ((this->*isJumpPoint)(nx, ny, dir))
+					jumpDistances[slot] = 1;
+				else if (jumpDistances[next] > 0)
+					jumpDistances[slot] = jumpDistances[next] + 1;
+				else
+					jumpDistances[slot] = jumpDistances[next] - 1;
+			}
+		}
+	};
+
+	// Horizontal first, since vertical jump points are defined by what the horizontal jumps find.
+	sweep(2, &NavigationGrid::IsHorizontalJumpPoint);
+	sweep(3, &NavigationGrid::IsHorizontalJumpPoint);
+	sweep(0, &NavigationGrid::IsVerticalJumpPoint);
+	sweep(1, &NavigationGrid::IsVerticalJumpPoint);
+}
+
+bool NavigationGrid::IsHorizontalJumpPoint(int x, int y, int dir) const
+{
+	return IsForced(x, y, dir, 0) || IsForced(x, y, dir, 1);
+}
+
+bool NavigationGrid::IsVerticalJumpPoint(int x, int y, int) const
+{
+	int node = CellIndex(x, y);
+	return jumpDistances[node * 4 + 2] > 0 || jumpDistances[node * 4 + 3] > 0;
+}
+
+// Where a jump from node in direction dir lands, or -1 if it runs into a wall with nothing worth stopping for.
+int NavigationGrid::FindJumpSuccessor(int node, int dir, int endNode, int& distance) const
+{
+	int x = node % gridWidth;
+	int y = node / gridWidth;
+	int goalX = endNode % gridWidth;
+	int goalY = endNode / gridWidth;
+
+	int jump = jumpDistances[node * 4 + dir];
+	int open = wallDistances[node * 4 + dir];
+
+	if (dir >= 2)
+	{
+		// Horizontal: stop early if the goal is on this row before the next jump point.
+		int toGoal = (goalX - x) * NEIGHBOUR_DX[dir];
+		if (goalY == y && toGoal > 0 && toGoal <= open && (jump <= 0 || toGoal <= jump))
+		{
+			distance = toGoal;
+			return endNode;
+		}
+	}
+	else
+	{
+		// Vertical: stop early on the goal's row if the goal can be walked to straight along it from there.
+		int toGoalRow = (goalY - y) * NEIGHBOUR_DY[dir];
+		if (toGoalRow > 0 && toGoalRow <= open && (jump <= 0 || toGoalRow <= jump))
+		{
+			int stop = CellIndex(x, goalY);
+			int horizontalDir = goalX > x ? 3 : 2;
+
+			if (goalX == x || abs(goalX - x) <= wallDistances[stop * 4 + horizontalDir])
+			{
+				distance = toGoalRow;
+				return stop;
+			}
+		}
+	}
+
+	if (jump <= 0)
+		return -1;
+
+	distance = jump;
+	return CellIndex(x + NEIGHBOUR_DX[dir] * jump, y + NEIGHBOUR_DY[dir] * jump);
+}
+
+bool NavigationGrid::FindPathJumpPoint(int endNode, NavigationSearchContext& context) const
+{
+	while (!context.open.IsEmpty())
+	{
+		int current = context.open.Pop();
+		context.closed[current] = true;
+		context.lastStats.nodesExpanded++;
+
+		if (current == endNode)
+			return true;
+
+		for (int d = 0; d < 4; ++d)
+		{
+			if (!IsCanonicalDirection(current, context.arrival[current], d))
+				continue;
+
+			int distance;
+			int successor = FindJumpSuccessor(current, d, endNode, distance);
+			if (successor >= 0)
+				RelaxNode(context, current, successor, (float)distance, d, endNode);
+		}
+	}
+	return false;
+}
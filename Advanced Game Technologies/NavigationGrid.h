@@ -0,0 +1,144 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A navigation grid loaded from a level file, searched with A* over flat arrays.
+Extends the framework grid with a world offset, per-search scratch data that can live on other threads,
+and an optional jump point search mode for the uniform cost levels.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "NavigationMap.h"
+#include "IndexedHeap.h"
+#include <string>
+#include <vector>
+
+namespace NCL {
+	namespace CSC8503 {
+		struct NavigationSearchStats
+		{
+			int nodesExpanded;
+			float milliseconds;
+		};
+
+		// Everything one A* search writes to. Nothing in here is cleared between searches- it's stamped with which search last touched it instead.
+		class NavigationSearchContext
+		{
+		public:
+			NavigationSearchContext() : currentSearch(0) {}
+
+			const NavigationSearchStats& GetLastStats() const { return lastStats; }
+
+		protected:
+			friend class NavigationGrid;
+
+			// Start a new search, resizing if this context was last used on a different sized grid.
+			void Begin(size_t nodeCount);
+
+			bool Touched(int node) const { return searchStamp[node] == currentSearch; }
+
+			std::vector<unsigned int> searchStamp;
+			std::vector<float> g;
+			std::vector<int> parent;
+			std::vector<unsigned char> closed;
+			// Which way each node was reached from, for jump point search. -1 for the start.
+			std::vector<signed char> arrival;
+			IndexedHeap<> open;
+			unsigned int currentSearch;
+
+			NavigationSearchStats lastStats;
+		};
+
+		class NavigationGrid : public NavigationMap
+		{
+		public:
+			enum SearchMode
+			{
+				ASTAR,
+				JUMP_POINT,
+			};
+
+			NavigationGrid();
+			NavigationGrid(const std::string& filename, const Vector3& offset = Vector3(0, 0, 0));
+			~NavigationGrid();
+
+			bool FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath) override;
+
+			// Thread safe as long as every thread brings its own context.
+			bool FindPath(const Vector3& from, const Vector3& to, NavigationPath& outPath, NavigationSearchContext& context) const;
+
+			const NavigationSearchStats& GetLastSearchStats() const { return defaultContext.GetLastStats(); }
+
+			// Jump point search gives the same length paths as plain A*, but only expands the nodes where the route can turn.
+			void SetSearchMode(SearchMode mode) { searchMode = mode; }
+			SearchMode GetSearchMode() const { return searchMode; }
+
+			int GetNodeSize() const { return nodeSize; }
+			int GetWidth() const { return gridWidth; }
+			int GetHeight() const { return gridHeight; }
+
+			bool IsWalkable(int x, int y) const { return x >= 0 && y >= 0 && x < gridWidth && y < gridHeight && walkable[CellIndex(x, y)]; }
+			int CellIndex(int x, int y) const { return y * gridWidth + x; }
+
+			// Opening or closing a cell after load, e.g. for a gate. Nothing can be searching the grid on another thread while this happens.
+			void SetWalkable(int x, int y, bool canWalk);
+			// Walls and the like in the level file, which stay shut whatever's opened or closed after load.
+			bool IsBlockedByLevel(int x, int y) const { return x < 0 || y < 0 || x >= gridWidth || y >= gridHeight || IsBlockedType(cellTypes[CellIndex(x, y)]); }
+
+			// Goes up every time a cell changes, so anything built from the grid can tell it's out of date,
+			// and look up which cells changed since the revision it was built at.
+			int GetRevision() const { return (int)changedCells.size(); }
+			int GetChangedCell(int revision) const { return changedCells[revision]; }
+
+			// False if the position is off the grid.
+			bool WorldToCell(const Vector3& position, int& x, int& y) const;
+			Vector3 CellToWorld(int x, int y) const;
+
+		protected:
+			static bool IsBlockedType(char type) { return type == 'x' || type == '#'; }
+
+			void BuildNeighbours();
+			float Heuristic(int from, int to) const;
+
+			bool FindPathAStar(int endNode, NavigationSearchContext& context) const;
+			bool FindPathJumpPoint(int endNode, NavigationSearchContext& context) const;
+
+			// Relax one successor of current, reached by travelling `distance` cells in direction `dir`.
+			void RelaxNode(NavigationSearchContext& context, int current, int neighbour, float distance, int dir, int endNode) const;
+
+			void BuildJumpTables();
+			bool IsForced(int x, int y, int horizontalDir, int verticalDir) const;
+			bool IsHorizontalJumpPoint(int x, int y, int dir) const;
+			bool IsVerticalJumpPoint(int x, int y, int dir) const;
+			bool IsCanonicalDirection(int node, int arrivedDir, int dir) const;
+			int FindJumpSuccessor(int node, int dir, int endNode, int& distance) const;
+
+			int nodeSize;
+			int gridWidth;
+			int gridHeight;
+			Vector3 offset;
+
+			std::vector<char> cellTypes;
+			std::vector<unsigned char> walkable;
+
+			// Index offsets for the four directions, plus a bit per cell for which of them can actually be moved into.
+			int neighbourOffsets[4];
+			std::vector<unsigned char> neighbourMask;
+
+			// Per cell and direction, worked out at load: how far to the next jump point (positive), or to the wall if there isn't one (zero or negative).
+			std::vector<int> jumpDistances;
+			// And how many open cells there are before the wall, regardless of jump points.
+			std::vector<int> wallDistances;
+
+			// Every cell changed since load, in order.
+			std::vector<int> changedCells;
+
+			SearchMode searchMode;
+
+			NavigationSearchContext defaultContext;
+		};
+	}
+}
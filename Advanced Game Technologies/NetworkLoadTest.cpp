@@ -0,0 +1,690 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A headless load test for the multiplayer server, built as its own console project with no renderer, window or sockets.
+Runs a dedicated server- the same sessions, packet dispatch, per-client snapshots with interest management and high score table
+the game's server uses- and a crowd of simulated clients against it over the in-process loopback transport.
+Each client joins, then sends a scripted stream of goose inputs every frame, tries to pick something up and asks for the high scores
+every so often, acknowledging snapshots as they come in like the real client. The geese just slide about under the inputs- the physics isn't what's being measured.
+
+Reports, for each number of clients up to the one asked for, the server's tick time, the bytes per second it sends and receives,
+how long goose inputs wait between the server receiving them and applying them, their whole trip from the client's send, and how many
+of the (reliable) pick up requests made it.
+
+Can also record what the server takes in during one run, and play a recording (from here or from the game's server) back through
+this test's server headlessly, as fast as it'll go- the same log always gives the same ticks. That's the game's own network, session,
+dispatch, snapshot and high score code, but not its physics or AI, so it'll reproduce a spike in handling packets and sending snapshots
+but not one in the game's simulation.
+
+Usage: NetworkLoadTest [clients] [simulated seconds] [latency ms] [loss %] [seed]
+       NetworkLoadTest record <file> [clients] [simulated seconds] [latency ms] [loss %] [seed]
+       NetworkLoadTest replay <file> [seed]
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "../CSC8503Common/GameObject.h"
+#include "NetworkScheduler.h"
+#include "PacketDispatcher.h"
+#include "SessionManager.h"
+#include "WorldSnapshot.h"
+#include "InterestManager.h"
+#include "GoosePrediction.h"
+#include "HighScoreTable.h"
+#include "LoopbackTransport.h"
+#include "PacketRecorder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace NCL;
+using namespace CSC8503;
+
+// Same rates and limits the game uses.
+const float SIM_STEP = 1.0f / 60.0f;
+const float SNAPSHOT_SEND_RATE = 20.0f;
+const float NETWORK_TICK_RATE = 30.0f;
+const float SESSION_TIMEOUT = 5.0f;
+const float RELEVANCE_RADIUS = 60.0f;
+const float FORCE_MAGNITUDE = 10.0f;
+
+// Roughly the multiplayer level- items and enemies spread over the park, a few of them always on the move.
+const float WORLD_SIZE = 200.0f;
+const int OTHER_OBJECTS = 64;
+const int WANDERING_OBJECTS = 16;
+
+const float TURN_INTERVAL = 2.0f;			// how often a scripted goose picks a new direction
+const float HIGH_SCORE_INTERVAL = 5.0f;		// how often each client opens the high score table
+const float PICK_UP_INTERVAL = 3.0f;		// how often each client presses pick up
+
+// Same channels the game uses.
+enum NetworkChannel
+{
+	GOOSE_INPUT_CHANNEL,
+	SNAPSHOT_CHANNEL,
+	SNAPSHOT_ACK_CHANNEL,
+	HIGH_SCORE_CHANNEL,
+	HIGH_SCORE_REQUEST_CHANNEL,
+	CONNECTION_CHANNEL,
+};
+
+template <>
+struct NCL::CSC8503::PacketTraits<NewPlayerPacket> : public FixedSizePacketTraits<NewPlayerPacket, Player_Connected> {};
+template <>
+struct NCL::CSC8503::PacketTraits<ClientPlayerInputPacket> : public FixedSizePacketTraits<ClientPlayerInputPacket, Client_Player_Input> {};
+
+float ElapsedMicroseconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+Vector3 RandomPosition(std::mt19937& random)
+{
+	std::uniform_real_distribution<float> coord(-WORLD_SIZE / 2, WORLD_SIZE / 2);
+	return Vector3(coord(random), 1.0f, coord(random));
+}
+
+// Enough of a goose for the server to push about- no collisions, just momentum and drag.
+struct SlidingBody
+{
+	GameObject* object;
+	Vector3 velocity;
+	float yaw = 0.0f;
+
+	void Step(const Vector3& force, float turn, float dt)
+	{
+		velocity = (velocity + force * dt) * 0.98f;
+		yaw += turn * dt;
+
+		Transform& transform = object->GetTransform();
+		Vector3 position = transform.GetWorldPosition() + velocity * dt;
+		// Keep everyone in the park.
+		position.x = std::max(-WORLD_SIZE / 2, std::min(WORLD_SIZE / 2, position.x));
+		position.z = std::max(-WORLD_SIZE / 2, std::min(WORLD_SIZE / 2, position.z));
+		transform.SetWorldPosition(position);
+		transform.SetLocalOrientation(Quaternion::AxisAngleToQuaterion(Vector3(0, 1, 0), yaw));
+	}
+};
+
+struct LoadStats
+{
+	std::vector<float> tickMicroseconds;
+	std::vector<float> receiveToApplyMicroseconds;
+	std::vector<float> sendToApplyMilliseconds;
+	int pickUpsSent = 0;
+	int pickUpsReceived = 0;
+};
+
+/* SERVER */
+
+class LoadTestServer
+{
+public:
+	LoadTestServer(LoopbackTransport& transport, int gooseCount, unsigned int seed, LoadStats& stats);
+	~LoadTestServer();
+
+	void Tick(float dt);
+
+	int GetAddress() const { return address; }
+	PacketRecorder* GetRecorder() const { return recorder; }
+	int GetTruncatedSnapshots() const { return snapshotSender.GetTruncatedSnapshots(); }
+
+	// The client side keeps the send times, so the server just notes when each input was applied for matching up afterwards.
+	struct AppliedInput
+	{
+		int peer;
+		int sequence;
+		float time;
+	};
+	const std::vector<AppliedInput>& GetAppliedInputs() const { return appliedInputs; }
+
+	void ReceiveGooseInput(const GooseInputPacket& packet, int source);
+	void ReceiveNewPlayer(const NewPlayerPacket& packet, int source);
+	void ReceiveSnapshotAck(const SnapshotAckPacket& packet, int source);
+	void ReceiveHighScoreRequest(const HighScoreRequestPacket& packet, int source);
+	void ReceivePickUp(const ClientPlayerInputPacket& packet, int source);
+
+protected:
+	typedef PacketRegistry<LoadTestServer> Packets;
+	typedef Packets::Dispatcher<
+		Packets::On<GooseInputPacket, &LoadTestServer::ReceiveGooseInput>,
+		Packets::On<NewPlayerPacket, &LoadTestServer::ReceiveNewPlayer>,
+		Packets::On<SnapshotAckPacket, &LoadTestServer::ReceiveSnapshotAck>,
+		Packets::On<HighScoreRequestPacket, &LoadTestServer::ReceiveHighScoreRequest>,
+		Packets::On<ClientPlayerInputPacket, &LoadTestServer::ReceivePickUp>
+	> Dispatcher;
+
+	void MoveGeese(float dt);
+	void MoveWanderers(float dt);
+	void SendSnapshots(float dt);
+
+	LoopbackTransport& transport;
+	LoadStats& stats;
+	int address;
+
+	Dispatcher* dispatcher;
+	SessionManager* sessions;
+	// Everything arrives through this- it only writes anything out once it's been started.
+	PacketRecorder* recorder;
+	SnapshotSender snapshotSender;
+	InterestManager interest;
+	HighScoreTable highScores;
+
+	std::vector<SlidingBody> geese;
+	std::vector<SlidingBody> others;
+	std::mt19937 random;
+
+	// When each session's newest input came off the wire, by the wall clock.
+	std::map<int, std::chrono::high_resolution_clock::time_point> inputReceived;
+	std::map<int, bool> inputPending;
+	// The newest input already counted in appliedInputs, per peer.
+	std::map<int, int> appliedUpTo;
+	std::vector<AppliedInput> appliedInputs;
+};
+
+LoadTestServer::LoadTestServer(LoopbackTransport& transport, int gooseCount, unsigned int seed, LoadStats& stats)
+	: transport(transport), stats(stats), snapshotSender(SNAPSHOT_SEND_RATE), interest(RELEVANCE_RADIUS), random(seed)
+{
+	dispatcher = new Dispatcher(this);
+	address = -1;
+	sessions = new SessionManager(NETWORK_TICK_RATE, SESSION_TIMEOUT,
+		[this](int peer, GamePacket& batch) { this->transport.Send(address, peer, batch); }, dispatcher,
+		[this](ClientSession& session) { snapshotSender.RemoveClient(session.peer); });
+	recorder = new PacketRecorder(sessions);
+	address = transport.AddEndpoint(recorder);
+
+	// Added in the same order as the game- geese first, then everything else.
+	for (int i = 0; i < gooseCount + OTHER_OBJECTS; ++i)
+	{
+		SlidingBody body;
+		body.object = new GameObject();
+		body.object->GetTransform().SetWorldPosition(RandomPosition(random));
+		(i < gooseCount ? geese : others).emplace_back(body);
+
+		snapshotSender.AddObject(body.object);
+		interest.AddObject(body.object);
+	}
+
+	highScores.Submit("Goose", 30);
+	highScores.Submit("Gander", 20);
+}
+
+LoadTestServer::~LoadTestServer()
+{
+	delete recorder;
+	delete sessions;
+	delete dispatcher;
+	for (SlidingBody& body : geese)
+		delete body.object;
+	for (SlidingBody& body : others)
+		delete body.object;
+}
+
+void LoadTestServer::ReceiveGooseInput(const GooseInputPacket& packet, int source)
+{
+	ClientSession* session = sessions->Find(source);
+	if (!session)
+		return;
+
+	int lastQueued = session->inputs.GetLastQueued();
+	if (!session->inputs.Receive(packet) || session->inputs.GetLastQueued() == lastQueued)
+		return;
+
+	inputReceived[source] = std::chrono::high_resolution_clock::now();
+	inputPending[source] = true;
+}
+
+void LoadTestServer::ReceiveNewPlayer(const NewPlayerPacket&, int source)
+{
+	ClientSession* session = sessions->Find(source);
+	if (!session)
+		return;
+
+	snapshotSender.AddClient(source);
+	// One goose per client here, so there's always one free.
+	if (session->gooseIndex < 0)
+	{
+		std::vector<bool> taken(geese.size(), false);
+		for (auto& entry : sessions->GetSessions())
+		{
+			if (entry.second.gooseIndex >= 0)
+				taken[entry.second.gooseIndex] = true;
+		}
+		for (int i = 0; i < (int)geese.size() && session->gooseIndex < 0; ++i)
+		{
+			if (!taken[i])
+				session->gooseIndex = i;
+		}
+	}
+	session->scheduler->Send(PlayerAssignPacket(session->gooseIndex), CONNECTION_CHANNEL, NetworkScheduler::RELIABLE);
+}
+
+void LoadTestServer::ReceiveSnapshotAck(const SnapshotAckPacket& packet, int source)
+{
+	snapshotSender.Acknowledge(source, packet.sequence);
+}
+
+void LoadTestServer::ReceiveHighScoreRequest(const HighScoreRequestPacket& packet, int source)
+{
+	ClientSession* session = sessions->Find(source);
+	if (!session)
+		return;
+
+	HighScoreUpdatePacket update;
+	highScores.WriteChanges(packet.knownTable, packet.knownVersion, update);
+	session->scheduler->Send(update, HIGH_SCORE_CHANNEL, NetworkScheduler::RELIABLE);
+}
+
+// There's nothing to pick up here, so just count them- every one should get through, however lossy the link.
+void LoadTestServer::ReceivePickUp(const ClientPlayerInputPacket&, int source)
+{
+	if (sessions->Find(source))
+		stats.pickUpsReceived++;
+}
+
+void LoadTestServer::MoveGeese(float dt)
+{
+	for (auto& entry : sessions->GetSessions())
+	{
+		ClientSession& session = entry.second;
+		if (session.gooseIndex < 0)
+			continue;
+
+		Vector3 force;
+		Vector3 torque;
+		bool active = session.inputs.Consume(dt, force, torque);
+		geese[session.gooseIndex].Step(force, torque.y, dt);
+
+		if (active && inputPending[session.peer])
+		{
+			stats.receiveToApplyMicroseconds.emplace_back(ElapsedMicroseconds(inputReceived[session.peer]));
+			inputPending[session.peer] = false;
+		}
+		int lastApplied = session.inputs.GetLastApplied();
+		if (lastApplied >= 0 && (appliedUpTo.count(session.peer) == 0 || lastApplied > appliedUpTo[session.peer]))
+		{
+			appliedInputs.push_back({ session.peer, lastApplied, transport.GetTime() });
+			appliedUpTo[session.peer] = lastApplied;
+		}
+	}
+}
+
+void LoadTestServer::MoveWanderers(float dt)
+{
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	for (int i = 0; i < WANDERING_OBJECTS && i < (int)others.size(); ++i)
+		others[i].Step(Vector3(unit(random), 0, unit(random)) * FORCE_MAGNITUDE, unit(random), dt);
+}
+
+void LoadTestServer::SendSnapshots(float dt)
+{
+	snapshotSender.SetTimeRemaining(180 - (int)transport.GetTime());
+	if (!snapshotSender.Update(dt))
+		return;
+
+	interest.Update();
+	for (auto& entry : sessions->GetSessions())
+	{
+		ClientSession& session = entry.second;
+		if (session.gooseIndex < 0)
+			continue;
+
+		interest.UpdateRelevance(geese[session.gooseIndex].object->GetTransform().GetWorldPosition(), session.relevant);
+		SnapshotPacket snapshot;
+		if (snapshotSender.Write(session.peer, -1, session.inputs.GetLastApplied(), &session.relevant, snapshot))
+			session.scheduler->Send(snapshot, SNAPSHOT_CHANNEL, NetworkScheduler::UNRELIABLE);
+	}
+}
+
+// Everything a dedicated server does in a frame- take in what's arrived, simulate, and send.
+void LoadTestServer::Tick(float dt)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	recorder->BeginTick(dt);
+	transport.Poll(address);
+	MoveGeese(dt);
+	MoveWanderers(dt);
+	SendSnapshots(dt);
+	sessions->Update(dt);
+
+	stats.tickMicroseconds.emplace_back(ElapsedMicroseconds(start));
+}
+
+/* CLIENTS */
+
+class LoadTestClient
+{
+public:
+	LoadTestClient(LoopbackTransport& transport, int serverAddress, int objectCount, unsigned int seed, LoadStats& stats);
+	~LoadTestClient();
+
+	void Tick(float dt);
+
+	int GetAddress() const { return address; }
+	// When each input went out, by the transport's clock.
+	float GetSendTime(int sequence) const { return sendTimes[sequence % SEND_HISTORY]; }
+
+	void ReceiveSnapshot(const SnapshotPacket& packet, int source);
+	void ReceivePlayerAssign(const PlayerAssignPacket& packet, int source);
+	void ReceiveHighScores(const HighScoreUpdatePacket& packet, int source);
+
+protected:
+	typedef PacketRegistry<LoadTestClient> Packets;
+	typedef Packets::Dispatcher<
+		Packets::On<SnapshotPacket, &LoadTestClient::ReceiveSnapshot>,
+		Packets::On<PlayerAssignPacket, &LoadTestClient::ReceivePlayerAssign>,
+		Packets::On<HighScoreUpdatePacket, &LoadTestClient::ReceiveHighScores>
+	> Dispatcher;
+
+	static const int SEND_HISTORY = 1024;
+
+	LoopbackTransport& transport;
+	LoadStats& stats;
+	int address;
+	int serverAddress;
+
+	Dispatcher dispatcher;
+	NetworkScheduler* scheduler;
+	SnapshotReceiver snapshotReceiver;
+	HighScoreTable highScores;
+	std::vector<GameObject*> objects;
+
+	int gooseIndex;
+	bool joined;
+	GoosePrediction prediction;
+	float sendTimes[SEND_HISTORY];
+
+	Vector3 direction;
+	float turnTimer;
+	float highScoreTimer;
+	float pickUpTimer;
+	std::mt19937 random;
+};
+
+LoadTestClient::LoadTestClient(LoopbackTransport& transport, int serverAddress, int objectCount, unsigned int seed, LoadStats& stats)
+	: transport(transport), stats(stats), dispatcher(this), snapshotReceiver(SNAPSHOT_SEND_RATE), random(seed)
+{
+	this->serverAddress = serverAddress;
+	address = -1;
+	scheduler = new NetworkScheduler(NETWORK_TICK_RATE, [this](GamePacket& batch) { this->transport.Send(address, this->serverAddress, batch); }, &dispatcher);
+	address = transport.AddEndpoint(scheduler);
+
+	for (int i = 0; i < objectCount; ++i)
+	{
+		objects.emplace_back(new GameObject());
+		snapshotReceiver.AddObject(objects.back());
+	}
+
+	gooseIndex = -1;
+	joined = false;
+	turnTimer = 0.0f;
+	// Spread out so the whole crowd isn't asking on the same frame.
+	highScoreTimer = std::uniform_real_distribution<float>(0.0f, HIGH_SCORE_INTERVAL)(random);
+	pickUpTimer = std::uniform_real_distribution<float>(0.0f, PICK_UP_INTERVAL)(random);
+}
+
+LoadTestClient::~LoadTestClient()
+{
+	delete scheduler;
+	for (GameObject* object : objects)
+		delete object;
+}
+
+void LoadTestClient::ReceiveSnapshot(const SnapshotPacket& packet, int)
+{
+	if (!snapshotReceiver.Read(packet))
+		return;
+	// Anything the server's got through needn't go in the inputs sent from now on.
+	prediction.Acknowledge(snapshotReceiver.GetLatest().lastInput);
+	scheduler->Send(SnapshotAckPacket(packet.sequence), SNAPSHOT_ACK_CHANNEL, NetworkScheduler::UNRELIABLE);
+}
+
+void LoadTestClient::ReceivePlayerAssign(const PlayerAssignPacket& packet, int)
+{
+	gooseIndex = packet.gooseIndex;
+	if (gooseIndex >= 0 && gooseIndex < (int)objects.size())
+		snapshotReceiver.SetOwnedLocally(objects[gooseIndex]);
+}
+
+void LoadTestClient::ReceiveHighScores(const HighScoreUpdatePacket& packet, int)
+{
+	highScores.ReadChanges(packet);
+}
+
+void LoadTestClient::Tick(float dt)
+{
+	transport.Poll(address);
+
+	if (!joined)
+	{
+		scheduler->Send(NewPlayerPacket(0), CONNECTION_CHANNEL, NetworkScheduler::RELIABLE);
+		joined = true;
+	}
+
+	snapshotReceiver.Update(dt);
+
+	// Wander about, turning every so often- an input goes every frame once there's a goose to move, the same as the game.
+	turnTimer -= dt;
+	if (turnTimer <= 0.0f)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		direction = Vector3(unit(random), 0, unit(random)).Normalised();
+		turnTimer = TURN_INTERVAL;
+	}
+	if (gooseIndex >= 0)
+	{
+		// Nothing's simulated here, so there's no pose worth remembering- the prediction's only used for its unacknowledged inputs.
+		int sequence = prediction.RecordInput(Vector3(0, 0, 0), Quaternion(), prediction.QuantiseInput(dt, direction * FORCE_MAGNITUDE, Vector3(0, direction.x, 0)));
+		sendTimes[sequence % SEND_HISTORY] = transport.GetTime();
+
+		GooseInputPacket inputs;
+		prediction.WriteInputs(inputs);
+		scheduler->Send(inputs, GOOSE_INPUT_CHANNEL, NetworkScheduler::UNRELIABLE);
+	}
+
+	highScoreTimer -= dt;
+	if (highScoreTimer <= 0.0f)
+	{
+		scheduler->Send(HighScoreRequestPacket(highScores.GetTableID(), highScores.GetVersion()), HIGH_SCORE_REQUEST_CHANNEL, NetworkScheduler::RELIABLE);
+		highScoreTimer = HIGH_SCORE_INTERVAL;
+	}
+
+	// The same as the game's pick up button- on no channel, so every press goes through rather than being merged with the last.
+	pickUpTimer -= dt;
+	if (pickUpTimer <= 0.0f && gooseIndex >= 0)
+	{
+		scheduler->Send(ClientPlayerInputPacket(), NetworkScheduler::NO_CHANNEL, NetworkScheduler::RELIABLE);
+		stats.pickUpsSent++;
+		pickUpTimer = PICK_UP_INTERVAL;
+	}
+
+	scheduler->Update(dt);
+}
+
+/* REPORTING */
+
+float Percentile(std::vector<float>& values, float percentile)
+{
+	if (values.empty())
+		return 0.0f;
+	size_t index = std::min<size_t>(values.size() - 1, (size_t)(percentile * values.size()));
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+float Mean(const std::vector<float>& values)
+{
+	double total = 0.0;
+	for (float value : values)
+		total += value;
+	return values.empty() ? 0.0f : (float)(total / values.size());
+}
+
+void RunScenario(int clientCount, float seconds, float latency, float loss, unsigned int seed, const std::string& recordFile = "")
+{
+	LoopbackTransport transport(latency, latency * 0.2f, loss, seed);
+	LoadStats stats;
+
+	LoadTestServer* server = new LoadTestServer(transport, clientCount, seed, stats);
+	std::vector<LoadTestClient*> clients;
+	for (int i = 0; i < clientCount; ++i)
+		clients.emplace_back(new LoadTestClient(transport, server->GetAddress(), clientCount + OTHER_OBJECTS, seed + 1 + i, stats));
+
+	if (!recordFile.empty() && !server->GetRecorder()->Start(recordFile))
+		printf("Couldn't open %s to record to.\n", recordFile.c_str());
+
+	int steps = (int)(seconds / SIM_STEP);
+	for (int step = 0; step < steps; ++step)
+	{
+		transport.Update(SIM_STEP);
+		for (LoadTestClient* client : clients)
+			client->Tick(SIM_STEP);
+		server->Tick(SIM_STEP);
+	}
+
+	// Addresses are handed out in order- the server's first, so client i is at i + 1.
+	for (const LoadTestServer::AppliedInput& input : server->GetAppliedInputs())
+	{
+		float sent = clients[input.peer - 1]->GetSendTime(input.sequence);
+		stats.sendToApplyMilliseconds.emplace_back((input.time - sent) * 1000.0f);
+	}
+
+	int address = server->GetAddress();
+	float egress = transport.GetBytesSent(address) / seconds / 1024.0f;
+	float ingress = transport.GetBytesReceived(address) / seconds / 1024.0f;
+
+	// Any still in flight when the run stops are the only ones that should be missing.
+	char pickUps[32];
+	snprintf(pickUps, sizeof(pickUps), "%d/%d", stats.pickUpsReceived, stats.pickUpsSent);
+
+	printf("  %7d %10.1f %10.1f %11.1f %11.2f %11.1f %9.1f %9.1f %9.1f %9.1f %11s\n", clientCount,
+		Mean(stats.tickMicroseconds), Percentile(stats.tickMicroseconds, 0.99f),
+		egress, egress / clientCount, ingress,
+		Percentile(stats.receiveToApplyMicroseconds, 0.5f), Percentile(stats.receiveToApplyMicroseconds, 0.99f),
+		Percentile(stats.sendToApplyMilliseconds, 0.5f), Percentile(stats.sendToApplyMilliseconds, 0.99f), pickUps);
+	if (server->GetTruncatedSnapshots() > 0)
+		printf("  %7s %d snapshots cut short to fit in a packet\n", "", server->GetTruncatedSnapshots());
+
+	PacketRecorder* recorder = server->GetRecorder();
+	if (recorder->IsRecording())
+	{
+		recorder->Stop();
+		printf("Recorded %d ticks to %s (%.1f KB).\n", recorder->GetTickCount(), recordFile.c_str(), recorder->GetBytesWritten() / 1024.0f);
+	}
+
+	for (LoadTestClient* client : clients)
+		delete client;
+	delete server;
+}
+
+// Stands in for a recorded client during playback- anything the server sends back is thrown away.
+class ReplayPeer : public PacketReceiver
+{
+public:
+	void ReceivePacket(int, GamePacket*, int) override {}
+};
+
+// Feeds a recording through the server in the ticks it arrived in, with no latency or loss and no waiting between ticks.
+// The server's own randomness comes from the seed, so the same log and seed always make the same ticks and send the same bytes.
+void RunReplay(const std::string& filename, unsigned int seed)
+{
+	PacketRecording recording;
+	if (!recording.Load(filename))
+	{
+		printf("Couldn't read a recording from %s.\n", filename.c_str());
+		return;
+	}
+
+	LoopbackTransport transport;
+	LoadStats stats;
+
+	// One goose for everyone who sent anything.
+	const std::vector<int>& sources = recording.GetSources();
+	LoadTestServer* server = new LoadTestServer(transport, (int)sources.size(), seed, stats);
+
+	// Recorded peers get an address each here- the server only ever uses them to tell clients apart.
+	ReplayPeer peer;
+	std::map<int, int> addresses;
+	for (int source : sources)
+		addresses[source] = transport.AddEndpoint(&peer);
+
+	float simulated = 0.0f;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int tick = 0; tick < recording.GetTickCount(); ++tick)
+	{
+		float dt = recording.GetTickTime(tick);
+		transport.Update(dt);
+		for (int i = 0; i < recording.GetPacketCount(tick); ++i)
+			transport.Send(addresses[recording.GetSource(tick, i)], server->GetAddress(), recording.GetPacket(tick, i));
+
+		server->Tick(dt);
+
+		for (auto& entry : addresses)
+			transport.Poll(entry.second);
+		simulated += dt;
+	}
+	float wallSeconds = ElapsedMicroseconds(start) / 1000000.0f;
+
+	// Tick times are kept in tick order, so the slowest one's index is the tick to go and look at.
+	int slowest = (int)(std::max_element(stats.tickMicroseconds.begin(), stats.tickMicroseconds.end()) - stats.tickMicroseconds.begin());
+	float slowestMicroseconds = stats.tickMicroseconds.empty() ? 0.0f : stats.tickMicroseconds[slowest];
+
+	printf("%s: %d ticks, %d packets from %d peers, %.1f recorded seconds\n", filename.c_str(), recording.GetTickCount(), recording.GetTotalPackets(), (int)sources.size(), simulated);
+	printf("  played back in %.3fs (%.0fx real time)\n", wallSeconds, wallSeconds > 0.0f ? simulated / wallSeconds : 0.0f);
+	printf("  tick %.1fus mean, %.1fus p99, slowest %.1fus at tick %d\n", Mean(stats.tickMicroseconds), Percentile(stats.tickMicroseconds, 0.99f), slowestMicroseconds, slowest);
+	printf("  server sent %lld bytes, received %lld\n", transport.GetBytesSent(server->GetAddress()), transport.GetBytesReceived(server->GetAddress()));
+
+	delete server;
+}
+
+int main(int argc, char** argv)
+{
+	std::string mode = argc > 1 ? argv[1] : "";
+	bool recording = mode == "record";
+	if ((recording || mode == "replay") && argc < 3)
+	{
+		printf("Usage: NetworkLoadTest %s <file> ...\n", mode.c_str());
+		return 1;
+	}
+	if (mode == "replay")
+	{
+		RunReplay(argv[2], argc > 3 ? (unsigned int)atoi(argv[3]) : 1);
+		return 0;
+	}
+
+	// Everything after the mode and file is the same as a normal run.
+	int first = recording ? 3 : 1;
+	int maxClients = argc > first ? atoi(argv[first]) : 32;
+	float seconds = argc > first + 1 ? (float)atof(argv[first + 1]) : 30.0f;
+	float latency = (argc > first + 2 ? (float)atof(argv[first + 2]) : 50.0f) / 1000.0f;
+	float loss = (argc > first + 3 ? (float)atof(argv[first + 3]) : 2.0f) / 100.0f;
+	unsigned int seed = argc > first + 4 ? (unsigned int)atoi(argv[first + 4]) : 1;
+
+	printf("%.0f simulated seconds per run, %.0fms latency, %.1f%% loss, seed %u\n", seconds, latency * 1000.0f, loss * 100.0f, seed);
+	printf("  %7s %10s %10s %11s %11s %11s %9s %9s %9s %9s %11s\n", "clients", "tick (us)", "p99 (us)", "out (KB/s)", "per client", "in (KB/s)",
+		"rx->apply", "p99 (us)", "tx->apply", "p99 (ms)", "pick ups");
+
+	// Just the one run when recording, so the log is all one session.
+	if (recording)
+	{
+		RunScenario(maxClients, seconds, latency, loss, seed, argv[2]);
+		return 0;
+	}
+
+	for (int clients = 1; clients <= maxClients; clients *= 2)
+	{
+		RunScenario(clients, seconds, latency, loss, seed);
+		// Always finish on the number asked for.
+		if (clients < maxClients && clients * 2 > maxClients)
+			RunScenario(maxClients, seconds, latency, loss, seed);
+	}
+
+	return 0;
+}
@@ -0,0 +1,207 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Gathers everything one end of the connection wants to send, and sends it batched at a fixed network tick.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "NetworkScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+using namespace NCL;
+using namespace CSC8503;
+
+namespace {
+	int PaddedSize(int size)
+	{
+		return (size + BATCH_MESSAGE_ALIGNMENT - 1) / BATCH_MESSAGE_ALIGNMENT * BATCH_MESSAGE_ALIGNMENT;
+	}
+}
+
+NetworkScheduler::NetworkScheduler(float tickRate, std::function<void(GamePacket&)> send, PacketReceiver* receiver)
+{
+	this->send = send;
+	this->receiver = receiver;
+	SetTickRate(tickRate);
+	tickTimer = 0.0f;
+
+	unreliableCount = 0;
+	nextReliableSequence = 0;
+	expectedReliableSequence = 0;
+	ackOwed = false;
+	lastBatchBytes = 0;
+}
+
+void NetworkScheduler::Send(const GamePacket& packet, int channel, Lane lane)
+{
+	const char* bytes = (const char*)&packet;
+	int size = (int)sizeof(GamePacket) + packet.size;
+	Message* target = nullptr;
+
+	if (lane == UNRELIABLE)
+	{
+		// Latest wins- anything already waiting on this channel is out of date now.
+		if (channel != NO_CHANNEL)
+		{
+			for (int i = 0; i < unreliableCount; ++i)
+			{
+				if (unreliable[i].channel == channel)
+					target = &unreliable[i];
+			}
+		}
+
+		if (!target)
+		{
+			// Messages are reused tick to tick, so their buffers only ever get allocated the once.
+			if (unreliableCount == (int)unreliable.size())
+				unreliable.emplace_back();
+			target = &unreliable[unreliableCount++];
+		}
+	}
+	else
+	{
+		// Can only replace one the other end hasn't seen yet- once it's been sent it has to arrive.
+		if (channel != NO_CHANNEL)
+		{
+			for (Message& message : pendingReliable)
+			{
+				if (message.channel == channel && !message.sent)
+					target = &message;
+			}
+		}
+
+		if (!target)
+		{
+			pendingReliable.emplace_back();
+			target = &pendingReliable.back();
+			target->sequence = nextReliableSequence++;
+			target->sent = false;
+		}
+	}
+
+	target->channel = channel;
+	target->bytes.assign(bytes, bytes + size);
+}
+
+void NetworkScheduler::Update(float dt)
+{
+	tickTimer += dt;
+	if (tickTimer < tickInterval)
+		return;
+	// One tick's worth at a time- no bursts of empty batches after a long frame.
+	tickTimer = fmodf(tickTimer, tickInterval);
+	Flush();
+}
+
+bool NetworkScheduler::Pack(MessageBatchPacket& batch, int& dataSize, const Message& message) const
+{
+	int size = (int)message.bytes.size();
+	int padded = PaddedSize(size);
+	if (dataSize + padded > MAX_BATCH_BYTES)
+		return false;
+
+	// Padded out to the next message's start, zeroed rather than sending whatever was left in the batch.
+	memcpy(batch.data + dataSize, message.bytes.data(), size);
+	memset(batch.data + dataSize + size, 0, padded - size);
+	dataSize += padded;
+	return true;
+}
+
+void NetworkScheduler::SendBatch(MessageBatchPacket& batch, int dataSize)
+{
+	batch.reliableAck = expectedReliableSequence;
+	batch.SetDataSize(dataSize);
+	send(batch);
+
+	lastBatchBytes = batch.GetTotalSize();
+	ackOwed = false;
+}
+
+void NetworkScheduler::Flush()
+{
+	MessageBatchPacket batch;
+	int dataSize = 0;
+
+	// Every reliable message that hasn't been acknowledged yet goes again, oldest first, as many as fit.
+	batch.firstReliable = pendingReliable.empty() ? nextReliableSequence : pendingReliable.front().sequence;
+	for (Message& message : pendingReliable)
+	{
+		if (!Pack(batch, dataSize, message))
+			break;
+		message.sent = true;
+		batch.reliableCount++;
+	}
+
+	for (int i = 0; i < unreliableCount; ++i)
+	{
+		if (Pack(batch, dataSize, unreliable[i]))
+			continue;
+
+		// Full up, so send this one and start another. Reliable messages only ever go in the first.
+		SendBatch(batch, dataSize);
+		batch.firstReliable = nextReliableSequence;
+		batch.reliableCount = 0;
+		dataSize = 0;
+
+		// Too big for any batch- nothing to be done for it.
+		if (!Pack(batch, dataSize, unreliable[i]))
+			continue;
+	}
+	unreliableCount = 0;
+
+	if (dataSize > 0 || ackOwed)
+		SendBatch(batch, dataSize);
+}
+
+void NetworkScheduler::Deliver(GamePacket* packet, int source)
+{
+	receiver->ReceivePacket(packet->type, packet, source);
+}
+
+void NetworkScheduler::ReceivePacket(int type, GamePacket* payload, int source)
+{
+	if (type != Message_Batch)
+		return;
+
+	MessageBatchPacket* batch = (MessageBatchPacket*)payload;
+
+	// Everything the other end has got can stop being resent.
+	while (!pendingReliable.empty() && pendingReliable.front().sequence < batch->reliableAck)
+		pendingReliable.pop_front();
+
+	char* data = batch->data;
+	int dataSize = std::min(batch->GetDataSize(), MAX_BATCH_BYTES);
+	int offset = 0;
+	int index = 0;
+
+	// Every message starts aligned (Pack pads them), so each is handed on in place.
+	while (offset + (int)sizeof(GamePacket) <= dataSize)
+	{
+		GamePacket* packet = (GamePacket*)(data + offset);
+		int size = (int)sizeof(GamePacket) + packet->size;
+		if (packet->size < 0 || offset + size > dataSize)
+			break;
+
+		if (index < batch->reliableCount)
+		{
+			// Only the very next one in order gets handed on- repeats have already been, and anything after a gap will come round again.
+			if (batch->firstReliable + index == expectedReliableSequence)
+			{
+				expectedReliableSequence++;
+				Deliver(packet, source);
+			}
+			ackOwed = true;
+		}
+		else
+		{
+			Deliver(packet, source);
+		}
+
+		offset += PaddedSize(size);
+		index++;
+	}
+}
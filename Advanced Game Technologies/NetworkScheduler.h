@@ -0,0 +1,116 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Gathers everything one end of the connection wants to send, and sends it at a fixed network tick rather than whenever the game happens to render a frame.
+Messages on the same channel replace each other until the tick (only the newest goose input or snapshot is worth sending), then everything left
+goes out batched together in one datagram.
+There are two lanes: unreliable messages are sent once and forgotten, reliable ones (item pickups, joining, the high scores) are numbered and
+sent again every tick until the other end acknowledges them, and are handed over in the order they were sent, exactly once.
+The framework only sends unreliably, so the reliable lane is built on top here.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "../CSC8503Common/NetworkBase.h"
+#include "PacketDispatcher.h"
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace NCL {
+	namespace CSC8503 {
+		// Biggest batch payload- enough for a full world snapshot plus the header, so that always fits in a batch of its own.
+		const int MAX_BATCH_BYTES = 1400;
+		// Every message in a batch starts on a multiple of this, so it can be handed on straight out of the batch without copying.
+		const int BATCH_MESSAGE_ALIGNMENT = 8;
+
+		struct MessageBatchPacket : public GamePacket
+		{
+			// Sequence number of the first reliable message in the data, and how many there are. They come before the unreliable ones.
+			int firstReliable;
+			int reliableCount;
+			// The next reliable message we're waiting on from the other end, i.e. everything before it has arrived.
+			int reliableAck;
+			// Aligned, so a message packed at a multiple of BATCH_MESSAGE_ALIGNMENT in is too- as long as the batch itself arrived in an aligned buffer, as the transports' are.
+			alignas(BATCH_MESSAGE_ALIGNMENT) char data[MAX_BATCH_BYTES];
+
+			MessageBatchPacket()
+			{
+				type = Message_Batch;
+				firstReliable = 0;
+				reliableCount = 0;
+				reliableAck = 0;
+				SetDataSize(0);
+			}
+
+			void SetDataSize(int bytes) { size = (short)(sizeof(int) * 3 + bytes); }
+			int GetDataSize() const { return size - (int)sizeof(int) * 3; }
+		};
+
+		class NetworkScheduler : public PacketReceiver
+		{
+		public:
+			enum Lane
+			{
+				UNRELIABLE,
+				RELIABLE,
+			};
+
+			// For messages that should never be merged with each other, e.g. every single click.
+			static const int NO_CHANNEL = -1;
+
+			// send puts a finished batch on the wire, and everything unpacked from incoming batches is handed on to receiver.
+			NetworkScheduler(float tickRate, std::function<void(GamePacket&)> send, PacketReceiver* receiver);
+			~NetworkScheduler() {}
+
+			// Copies the packet, so temporaries are fine.
+			void Send(const GamePacket& packet, int channel, Lane lane);
+
+			// Sends everything gathered since the last tick, if a tick's due.
+			void Update(float dt);
+
+			void ReceivePacket(int type, GamePacket* payload, int source = -1) override;
+
+			void SetTickRate(float rate) { tickInterval = 1.0f / rate; }
+			float GetTickInterval() const { return tickInterval; }
+
+			int GetPendingReliableCount() const { return (int)pendingReliable.size(); }
+			int GetLastBatchBytes() const { return lastBatchBytes; }
+
+		protected:
+			struct Message
+			{
+				int channel;
+				int sequence;
+				// Reliable messages that haven't gone out yet can still be replaced by newer ones on their channel.
+				bool sent;
+				std::vector<char> bytes;
+			};
+
+			void Flush();
+			// False if there's no room left in this batch for it.
+			bool Pack(MessageBatchPacket& batch, int& dataSize, const Message& message) const;
+			void SendBatch(MessageBatchPacket& batch, int dataSize);
+			void Deliver(GamePacket* packet, int source);
+
+			std::function<void(GamePacket&)> send;
+			PacketReceiver* receiver;
+
+			float tickInterval;
+			float tickTimer;
+
+			std::vector<Message> unreliable;
+			int unreliableCount;
+			std::deque<Message> pendingReliable;
+			int nextReliableSequence;
+			int expectedReliableSequence;
+			// Something's arrived that the other end needs to hear we've got, even if we've nothing of our own to send.
+			bool ackOwed;
+
+			int lastBatchBytes;
+		};
+	}
+}
@@ -0,0 +1,115 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Runs the network on a thread of its own, handing packets to and from the game loop through a pair of lock free rings.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "NetworkThread.h"
+#include <chrono>
+#include <cstring>
+using namespace NCL;
+using namespace CSC8503;
+
+NetworkThread::NetworkThread(std::function<void()> poll, std::function<void(int, GamePacket&)> send, int pollInterval)
+{
+	this->poll = poll;
+	this->send = send;
+	this->pollInterval = pollInterval;
+	running = false;
+	droppedIncoming = 0;
+	droppedOutgoing = 0;
+}
+
+NetworkThread::~NetworkThread()
+{
+	Stop();
+}
+
+void NetworkThread::Start()
+{
+	if (running)
+		return;
+	running = true;
+	thread = std::thread(&NetworkThread::ThreadLoop, this);
+}
+
+void NetworkThread::Stop()
+{
+	if (!running)
+		return;
+	running = false;
+	thread.join();
+	// Anything the game loop queued after the thread's last look.
+	SendQueued();
+}
+
+void NetworkThread::ThreadLoop()
+{
+	while (running)
+	{
+		SendQueued();
+		poll();
+		// ENet doesn't block waiting for anything here, so without a rest this would spin a whole core.
+		std::this_thread::sleep_for(std::chrono::milliseconds(pollInterval));
+	}
+}
+
+void NetworkThread::SendQueued()
+{
+	while (QueuedPacket* slot = outgoing.Front())
+	{
+		send(slot->peer, *(GamePacket*)slot->data);
+		outgoing.Pop();
+	}
+}
+
+bool NetworkThread::Copy(QueuedPacket& slot, int peer, const GamePacket& packet)
+{
+	int size = (int)sizeof(GamePacket) + packet.size;
+	if (packet.size < 0 || size > MAX_QUEUED_PACKET_BYTES)
+		return false;
+	slot.peer = peer;
+	memcpy(slot.data, &packet, size);
+	return true;
+}
+
+void NetworkThread::ReceivePacket(int, GamePacket* payload, int source)
+{
+	// If the game loop's fallen that far behind, the newest is dropped- the scheduler's reliable channels send it again.
+	QueuedPacket* slot = incoming.Claim();
+	if (!slot || !Copy(*slot, source, *payload))
+	{
+		droppedIncoming++;
+		return;
+	}
+	incoming.Publish();
+}
+
+bool NetworkThread::Send(int peer, GamePacket& packet)
+{
+	QueuedPacket* slot = outgoing.Claim();
+	if (!slot || !Copy(*slot, peer, packet))
+	{
+		droppedOutgoing++;
+		return false;
+	}
+	outgoing.Publish();
+	return true;
+}
+
+int NetworkThread::Drain(PacketReceiver* receiver)
+{
+	int count = 0;
+	while (QueuedPacket* slot = incoming.Front())
+	{
+		GamePacket* packet = (GamePacket*)slot->data;
+		receiver->ReceivePacket(packet->type, packet, slot->peer);
+		incoming.Pop();
+		count++;
+	}
+	return count;
+}
@@ -0,0 +1,75 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Runs the network on a thread of its own, so packets aren't left waiting behind a slow frame.
+ENet isn't safe to touch from two threads at once, so once it's started this thread is the only one that does- it polls the
+host, copies every batch that arrives into a ring for the game loop, and sends whatever the game loop has queued up in a ring
+going the other way. The game loop drains what's arrived at the start of each tick, so everything that changes game state still
+happens on the main thread, just without having to wait for it to get round to polling.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "../CSC8503Common/NetworkBase.h"
+#include "SPSCRingBuffer.h"
+#include <functional>
+#include <thread>
+#include <atomic>
+
+namespace NCL {
+	namespace CSC8503 {
+		// Big enough for anything that fits in one datagram.
+		const int MAX_QUEUED_PACKET_BYTES = 1500;
+
+		class NetworkThread : public PacketReceiver
+		{
+		public:
+			// poll is UpdateServer/UpdateClient (or anything else that hands arrived packets to this), send puts a packet on the wire to a peer.
+			NetworkThread(std::function<void()> poll, std::function<void(int, GamePacket&)> send, int pollInterval = 1);
+			~NetworkThread();
+
+			void Start();
+			// Waits for the thread to finish- anything still queued to go out is sent first.
+			void Stop();
+
+			// Network thread- copies the packet in for the game loop to pick up.
+			void ReceivePacket(int type, GamePacket* payload, int source) override;
+
+			// Main thread- queues a packet for the network thread to send. Returns false if the queue's full (or it's too big).
+			bool Send(int peer, GamePacket& packet);
+			// Main thread- hands everything that's arrived since the last call to the receiver, oldest first. Returns how many.
+			int Drain(PacketReceiver* receiver);
+
+			int GetDroppedIncoming() const { return droppedIncoming; }
+			int GetDroppedOutgoing() const { return droppedOutgoing; }
+
+		protected:
+			struct QueuedPacket
+			{
+				int peer;
+				// Plain bytes so a packet can be copied in and read back out as one, kept 8 byte aligned so its fields can be read in place.
+				alignas(8) char data[MAX_QUEUED_PACKET_BYTES];
+			};
+
+			void ThreadLoop();
+			void SendQueued();
+			static bool Copy(QueuedPacket& slot, int peer, const GamePacket& packet);
+
+			SPSCRingBuffer<QueuedPacket, 512> incoming;
+			SPSCRingBuffer<QueuedPacket, 256> outgoing;
+
+			std::function<void()> poll;
+			std::function<void(int, GamePacket&)> send;
+			int pollInterval;
+
+			std::thread thread;
+			std::atomic<bool> running;
+			// Only ever written by one thread each- droppedIncoming by the network thread, droppedOutgoing by the main thread.
+			std::atomic<int> droppedIncoming;
+			std::atomic<int> droppedOutgoing;
+		};
+	}
+}
@@ -0,0 +1,108 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Handing incoming packets to the right function without a chain of ifs on their type.
+Each end lists which packet structs it listens for and which of its receiver's functions handles each one, e.g.
+
+	typedef PacketRegistry<ClientPacketReceiver> ClientPackets;
+	typedef ClientPackets::Dispatcher<
+		ClientPackets::On<SnapshotPacket, &ClientPacketReceiver::ReceiveSnapshot>,
+		...> ClientPacketDispatcher;
+
+and that list is turned into a table indexed straight by packet type, so dispatching is one lookup however many types there are.
+Handlers get the packet as its own struct, pointing straight into the receive buffer- nothing's copied.
+Anything with a type nobody's listening for, or too short to be the struct it claims to be, is thrown away and counted.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "../CSC8503Common/NetworkBase.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		// Packet types added on top of the framework's and the coursework's, which all sit below these.
+		// Every type has to be below MAX_PACKET_TYPES to fit in the table- registering one that isn't won't compile.
+		enum ExtendedNetworkTypes
+		{
+			Message_Batch = 32,
+			Goose_Input,
+			High_Score_Request,
+			High_Score_Update,
+			Player_Assign,
+
+			MAX_PACKET_TYPES = 64
+		};
+
+		// Which type number goes with each packet struct, and the least it can hold after the header. Specialised next to each packet.
+		template <typename Packet>
+		struct PacketTraits;
+
+		// Most packets are a fixed size, so the whole struct has to have arrived.
+		template <typename Packet, int TypeNumber>
+		struct FixedSizePacketTraits
+		{
+			static const int Type = TypeNumber;
+			static const int MinSize = (int)(sizeof(Packet) - sizeof(GamePacket));
+		};
+
+		template <typename Handler>
+		struct PacketRegistry
+		{
+			typedef bool (*Entry)(Handler& handler, const GamePacket& packet, int source);
+
+			// Binds a packet struct to the handler function for it.
+			template <typename Packet, void (Handler::*Method)(const Packet&, int)>
+			struct On
+			{
+				static_assert(PacketTraits<Packet>::Type >= 0 && PacketTraits<Packet>::Type < MAX_PACKET_TYPES, "Packet type doesn't fit in the dispatch table");
+
+				static void Register(Entry* table)
+				{
+					table[PacketTraits<Packet>::Type] = &Call;
+				}
+
+				static bool Call(Handler& handler, const GamePacket& packet, int source)
+				{
+					if (packet.size < PacketTraits<Packet>::MinSize)
+						return false;
+					(handler.*Method)(static_cast<const Packet&>(packet), source);
+					return true;
+				}
+			};
+
+			template <typename... Bindings>
+			class Dispatcher : public PacketReceiver
+			{
+			public:
+				Dispatcher(Handler* handler)
+				{
+					this->handler = handler;
+					rejectedCount = 0;
+
+					for (Entry& entry : table)
+						entry = nullptr;
+					// Fills in one entry per binding.
+					int expand[] = { 0, (Bindings::Register(table), 0)... };
+					(void)expand;
+				}
+				~Dispatcher() {}
+
+				void ReceivePacket(int type, GamePacket* payload, int source = -1) override
+				{
+					if (type < 0 || type >= MAX_PACKET_TYPES || !table[type] || !table[type](*handler, *payload, source))
+						rejectedCount++;
+				}
+
+				int GetRejectedCount() const { return rejectedCount; }
+
+			protected:
+				Handler* handler;
+				Entry table[MAX_PACKET_TYPES];
+				int rejectedCount;
+			};
+		};
+	}
+}
@@ -0,0 +1,204 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Records everything the server takes in, tick by tick, to a compact binary log, and reads it back for playback.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "PacketRecorder.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+using namespace NCL;
+using namespace CSC8503;
+
+namespace {
+	const char LOG_MAGIC[4] = { 'G', 'R', 'E', 'C' };
+	// 2- batched messages are padded to 8 bytes each.
+	const int LOG_VERSION = 2;
+	const int FLUSH_BYTES = 64 * 1024;
+
+	enum RecordType : char
+	{
+		TICK_RECORD,
+		PACKET_RECORD,
+	};
+
+	bool ReadVarInt(const std::vector<char>& bytes, size_t& position, unsigned int& value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 35; shift += 7)
+		{
+			if (position >= bytes.size())
+				return false;
+			unsigned char byte = (unsigned char)bytes[position++];
+			value |= (unsigned int)(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+}
+
+PacketRecorder::PacketRecorder(PacketReceiver* target)
+{
+	this->target = target;
+	tickCount = 0;
+	bytesWritten = 0;
+}
+
+PacketRecorder::~PacketRecorder()
+{
+	Stop();
+}
+
+bool PacketRecorder::Start(const std::string& filename)
+{
+	Stop();
+	file.open(filename, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	tickCount = 0;
+	bytesWritten = 0;
+	buffer.clear();
+	buffer.insert(buffer.end(), LOG_MAGIC, LOG_MAGIC + sizeof(LOG_MAGIC));
+	buffer.insert(buffer.end(), (const char*)&LOG_VERSION, (const char*)&LOG_VERSION + sizeof(LOG_VERSION));
+	return true;
+}
+
+void PacketRecorder::Stop()
+{
+	if (!file.is_open())
+		return;
+	Flush();
+	file.close();
+}
+
+void PacketRecorder::Flush()
+{
+	file.write(buffer.data(), buffer.size());
+	bytesWritten += buffer.size();
+	buffer.clear();
+}
+
+// Seven bits at a time, lowest first- peers, sizes and so on are nearly always small, so nearly always one byte.
+void PacketRecorder::WriteVarInt(unsigned int value)
+{
+	while (value >= 0x80)
+	{
+		buffer.emplace_back((char)((value & 0x7f) | 0x80));
+		value >>= 7;
+	}
+	buffer.emplace_back((char)value);
+}
+
+void PacketRecorder::BeginTick(float dt)
+{
+	if (!file.is_open())
+		return;
+
+	// A tick's packets are never split across a flush, so a log cut short still ends on a whole tick.
+	if (buffer.size() >= FLUSH_BYTES)
+		Flush();
+
+	buffer.emplace_back(TICK_RECORD);
+	buffer.insert(buffer.end(), (const char*)&dt, (const char*)&dt + sizeof(dt));
+	tickCount++;
+}
+
+void PacketRecorder::ReceivePacket(int type, GamePacket* payload, int source)
+{
+	if (file.is_open())
+	{
+		int size = (int)sizeof(GamePacket) + payload->size;
+		buffer.emplace_back(PACKET_RECORD);
+		WriteVarInt((unsigned int)source);
+		WriteVarInt((unsigned int)size);
+		buffer.insert(buffer.end(), (const char*)payload, (const char*)payload + size);
+	}
+	target->ReceivePacket(type, payload, source);
+}
+
+bool PacketRecording::Load(const std::string& filename)
+{
+	ticks.clear();
+	packets.clear();
+	data.clear();
+	sources.clear();
+
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open())
+		return false;
+	std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	int version = 0;
+	if (bytes.size() < sizeof(LOG_MAGIC) + sizeof(version) || memcmp(bytes.data(), LOG_MAGIC, sizeof(LOG_MAGIC)) != 0)
+		return false;
+	memcpy(&version, bytes.data() + sizeof(LOG_MAGIC), sizeof(version));
+	if (version != LOG_VERSION)
+		return false;
+
+	size_t position = sizeof(LOG_MAGIC) + sizeof(version);
+	// Where the tick being read started, so a record that's only partly there can take the rest of its tick with it.
+	size_t wholeTicks = 0;
+	size_t wholePackets = 0;
+	size_t wholeData = 0;
+	bool complete = true;
+
+	while (position < bytes.size() && complete)
+	{
+		char record = bytes[position++];
+		if (record == TICK_RECORD)
+		{
+			wholeTicks = ticks.size();
+			wholePackets = packets.size();
+			wholeData = data.size();
+
+			Tick tick;
+			complete = position + sizeof(tick.dt) <= bytes.size();
+			if (!complete)
+				break;
+			memcpy(&tick.dt, &bytes[position], sizeof(tick.dt));
+			position += sizeof(tick.dt);
+			tick.firstPacket = (int)packets.size();
+			tick.packetCount = 0;
+			ticks.emplace_back(tick);
+			continue;
+		}
+
+		unsigned int source;
+		unsigned int size;
+		complete = record == PACKET_RECORD && !ticks.empty() && ReadVarInt(bytes, position, source) && ReadVarInt(bytes, position, size)
+			&& size >= sizeof(GamePacket) && size <= bytes.size() - position;
+		if (!complete)
+			break;
+
+		Packet packet;
+		packet.source = (int)source;
+		packet.offset = (int)data.size();
+		data.resize(data.size() + (size + sizeof(long long) - 1) / sizeof(long long));
+		memcpy(&data[packet.offset], &bytes[position], size);
+		position += size;
+
+		packets.emplace_back(packet);
+		ticks.back().packetCount++;
+	}
+
+	if (!complete)
+	{
+		ticks.resize(wholeTicks);
+		packets.resize(wholePackets);
+		data.resize(wholeData);
+	}
+
+	for (const Packet& packet : packets)
+	{
+		if (std::find(sources.begin(), sources.end(), packet.source) == sources.end())
+			sources.emplace_back(packet.source);
+	}
+	return true;
+}
@@ -0,0 +1,100 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Records everything the server takes in, tick by tick, so a bad session can be played back offline and profiled.
+The recorder sits in front of the server's sessions and passes everything straight on to them, writing each packet (who it's from
+and its bytes) to a compact binary log on the way through. Each server tick starts with a tick record holding that tick's frame time,
+so a packet's tick number is how many tick records come before it, and played back in order the server sees exactly what it saw live.
+A log has to start before any client's connected- the sessions' reliable channels pick up where they left off, so a log that joins part way
+through a session has nothing to start them from, and played back every reliable message in it would be held waiting for ones it never got.
+
+Log format, after a 4 byte "GREC" and a version int:
+	TICK_RECORD		- one byte, then the frame time as a float
+	PACKET_RECORD	- one byte, then the source and the packet's total size as variable length ints, then the packet itself
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "../CSC8503Common/NetworkBase.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace NCL {
+	namespace CSC8503 {
+		class PacketRecorder : public PacketReceiver
+		{
+		public:
+			PacketRecorder(PacketReceiver* target);
+			~PacketRecorder();
+
+			// Starts a new log, replacing anything already in the file. Returns false if it can't be opened. Only before any sessions are open.
+			bool Start(const std::string& filename);
+			// Writes out whatever's still buffered and closes the log.
+			void Stop();
+			bool IsRecording() const { return file.is_open(); }
+
+			// Call at the start of each server tick, before anything's received in it.
+			void BeginTick(float dt);
+
+			void ReceivePacket(int type, GamePacket* payload, int source) override;
+
+			int GetTickCount() const { return tickCount; }
+			long long GetBytesWritten() const { return bytesWritten; }
+
+		protected:
+			void WriteVarInt(unsigned int value);
+			void Flush();
+
+			PacketReceiver* target;
+			std::ofstream file;
+			// Written out in chunks rather than a little at a time, so recording doesn't add a file write to every packet.
+			std::vector<char> buffer;
+			int tickCount;
+			long long bytesWritten;
+		};
+
+		// A log read back into memory, with every packet 8 byte aligned so it can be handed over in place.
+		class PacketRecording
+		{
+		public:
+			PacketRecording() {}
+			~PacketRecording() {}
+
+			// Returns false if the file can't be read or isn't a log. A log cut short (say the server crashed) keeps every whole tick.
+			bool Load(const std::string& filename);
+
+			int GetTickCount() const { return (int)ticks.size(); }
+			float GetTickTime(int tick) const { return ticks[tick].dt; }
+			int GetPacketCount(int tick) const { return ticks[tick].packetCount; }
+			int GetSource(int tick, int i) const { return packets[ticks[tick].firstPacket + i].source; }
+			const GamePacket& GetPacket(int tick, int i) const { return *(const GamePacket*)&data[packets[ticks[tick].firstPacket + i].offset]; }
+
+			int GetTotalPackets() const { return (int)packets.size(); }
+			// Every distinct source, in the order they first sent anything.
+			const std::vector<int>& GetSources() const { return sources; }
+
+		protected:
+			struct Tick
+			{
+				float dt;
+				int firstPacket;
+				int packetCount;
+			};
+
+			struct Packet
+			{
+				int source;
+				int offset;
+			};
+
+			std::vector<Tick> ticks;
+			std::vector<Packet> packets;
+			std::vector<long long> data;
+			std::vector<int> sources;
+		};
+	}
+}
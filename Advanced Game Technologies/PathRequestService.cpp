@@ -0,0 +1,234 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A queue of pathfinding requests run on a small pool of worker threads.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "PathRequestService.h"
+#include <algorithm>
+#include <cmath>
+using namespace NCL;
+using namespace CSC8503;
+
+PathRequestService::PathRequestService(int workerCount, int maxRequestsPerFrame)
+{
+	nextTicket = 1;
+	this->maxRequestsPerFrame = maxRequestsPerFrame;
+	busyWorkers = 0;
+	paused = false;
+	shuttingDown = false;
+
+	grid = nullptr;
+	hierarchy = nullptr;
+	workerContexts.resize(workerCount);
+	hierarchyContexts.resize(workerCount);
+	for (int i = 0; i < workerCount; ++i)
+		workers.emplace_back(&PathRequestService::WorkerLoop, this, i);
+}
+
+PathRequestService::~PathRequestService()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		shuttingDown = true;
+	}
+	workAvailable.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void PathRequestService::SetLevel(const NavigationGrid* grid, const HierarchicalGrid* hierarchy)
+{
+	// Nothing asked for on the old level means anything on the new one.
+	pending.clear();
+	latestTickets.clear();
+	results.clear();
+
+	std::unique_lock<std::mutex> lock(queueMutex);
+	workQueue.clear();
+	dispatchedTickets.clear();
+	workFinished.wait(lock, [this] { return busyWorkers == 0; });
+	completed.clear();
+
+	this->grid = grid;
+	this->hierarchy = hierarchy;
+}
+
+void PathRequestService::Pause()
+{
+	std::unique_lock<std::mutex> lock(queueMutex);
+	paused = true;
+	workFinished.wait(lock, [this] { return busyWorkers == 0; });
+}
+
+void PathRequestService::Resume()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		paused = false;
+	}
+	workAvailable.notify_all();
+}
+
+void PathRequestService::RequestPath(const GameObject* agent, const Vector3& start, const Vector3& goal, int priority)
+{
+	// A newer request replaces whatever this agent already had waiting.
+	CancelRequests(agent);
+
+	PathRequest request;
+	request.agent = agent;
+	request.start = start;
+	request.goal = goal;
+	request.priority = priority;
+	request.ticket = nextTicket++;
+
+	latestTickets[agent] = request.ticket;
+	pending.emplace_back(request);
+}
+
+void PathRequestService::CancelRequests(const GameObject* agent)
+{
+	pending.erase(std::remove_if(pending.begin(), pending.end(), [agent](const PathRequest& r) { return r.agent == agent; }), pending.end());
+	latestTickets.erase(agent);
+	results.erase(agent);
+
+	// Anything already handed to the workers gets skipped (or its result dropped) once its ticket no longer matches.
+	std::lock_guard<std::mutex> lock(queueMutex);
+	dispatchedTickets.erase(agent);
+}
+
+bool PathRequestService::TakeResult(const GameObject* agent, NavigationPath& outPath, bool& found)
+{
+	HierarchicalPath unusedRoute;
+	return TakeResult(agent, outPath, unusedRoute, found);
+}
+
+bool PathRequestService::TakeResult(const GameObject* agent, NavigationPath& outPath, HierarchicalPath& outRoute, bool& found)
+{
+	auto it = results.find(agent);
+	if (it == results.end())
+		return false;
+
+	outPath = it->second.path;
+	outRoute = it->second.route;
+	found = it->second.found;
+	results.erase(it);
+	return true;
+}
+
+void PathRequestService::Update()
+{
+	std::vector<std::pair<const GameObject*, PathResult>> finished;
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		finished.swap(completed);
+	}
+
+	// Only keep results that are still the newest thing their agent asked for.
+	finishedSearches.clear();
+	for (auto& result : finished)
+	{
+		finishedSearches.emplace_back(result.second.stats);
+
+		auto latest = latestTickets.find(result.first);
+		if (latest == latestTickets.end() || latest->second != result.second.ticket)
+			continue;
+
+		latestTickets.erase(latest);
+		results[result.first] = result.second;
+	}
+
+	if (pending.empty())
+		return;
+
+	// Highest priority first, then oldest first- whatever doesn't fit in this frame's budget waits for the next.
+	std::stable_sort(pending.begin(), pending.end(), [](const PathRequest& a, const PathRequest& b) { return a.priority > b.priority; });
+
+	int dispatchCount = std::min<int>((int)pending.size(), maxRequestsPerFrame);
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		for (int i = 0; i < dispatchCount; ++i)
+		{
+			dispatchedTickets[pending[i].agent] = pending[i].ticket;
+			workQueue.emplace_back(pending[i]);
+		}
+	}
+	pending.erase(pending.begin(), pending.begin() + dispatchCount);
+
+	workAvailable.notify_all();
+}
+
+bool PathRequestService::IsLatest(const PathRequest& request) const
+{
+	auto it = dispatchedTickets.find(request.agent);
+	return it != dispatchedTickets.end() && it->second == request.ticket;
+}
+
+void PathRequestService::WorkerLoop(int workerIndex)
+{
+	while (true)
+	{
+		PathRequest request;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			workAvailable.wait(lock, [this] { return shuttingDown || (!paused && !workQueue.empty()); });
+
+			if (shuttingDown)
+				return;
+
+			request = workQueue.front();
+			workQueue.pop_front();
+
+			// Cancelled, or replaced by a newer request, since it was queued.
+			if (!IsLatest(request))
+				continue;
+
+			busyWorkers++;
+		}
+
+		PathResult result;
+		result.ticket = request.ticket;
+		result.found = FindPath(request, result, workerIndex);
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			if (IsLatest(request))
+			{
+				dispatchedTickets.erase(request.agent);
+				completed.emplace_back(request.agent, result);
+			}
+			busyWorkers--;
+		}
+		workFinished.notify_all();
+	}
+}
+
+// Anything within a cluster or so of the goal isn't worth the abstract search- plain A* over the grid is already cheap there.
+bool PathRequestService::FindPath(const PathRequest& request, PathResult& result, int workerIndex) const
+{
+	if (!grid)
+		return false;
+
+	float hierarchicalDistance = hierarchy ? (float)(hierarchy->GetClusterSize() * grid->GetNodeSize()) : 0.0f;
+	Vector3 offset = request.goal - request.start;
+
+	if (!hierarchy || fabsf(offset.x) + fabsf(offset.z) <= hierarchicalDistance)
+	{
+		bool found = grid->FindPath(request.start, request.goal, result.path, workerContexts[workerIndex]);
+		result.stats = workerContexts[workerIndex].GetLastStats();
+		return found;
+	}
+
+	bool found = hierarchy->FindPath(request.start, request.goal, result.route, hierarchyContexts[workerIndex]);
+	result.stats = hierarchyContexts[workerIndex].GetLastStats();
+	if (!found)
+		return false;
+
+	result.route.NextSegment(result.path);
+	return true;
+}
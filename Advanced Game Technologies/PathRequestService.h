@@ -0,0 +1,112 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A queue of pathfinding requests run on a small pool of worker threads.
+Enemies submit where they are and where they want to go, and pick the finished path up a frame or two later
+instead of stalling the game loop with A* in the middle of their state update.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "../CSC8503Common/NavigationGrid.h"
+#include "../CSC8503Common/HierarchicalGrid.h"
+#include <vector>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace NCL {
+	namespace CSC8503 {
+		class GameObject;
+
+		struct PathRequest
+		{
+			const GameObject* agent;
+			Vector3 start;
+			Vector3 goal;
+			int priority;
+			unsigned int ticket;
+		};
+
+		struct PathResult
+		{
+			unsigned int ticket;
+			bool found;
+			NavigationPath path;
+			// Set for long requests planned over the cluster graph- path then only holds the first stretch of it.
+			HierarchicalPath route;
+			NavigationSearchStats stats;
+		};
+
+		class PathRequestService
+		{
+		public:
+			PathRequestService(int workerCount = 2, int maxRequestsPerFrame = 8);
+			~PathRequestService();
+
+			// Switch to a new level's grid. Waits for anything in flight to finish first.
+			// With a hierarchy, requests further apart than a cluster are planned over it instead of the full grid.
+			void SetLevel(const NavigationGrid* grid, const HierarchicalGrid* hierarchy = nullptr);
+
+			// Hold the workers while cells in the grid are changed under them, e.g. a gate opening. Pause waits for anything in flight to finish.
+			void Pause();
+			void Resume();
+
+			// Queue up a path for an agent. Anything the agent asked for before and hasn't been given yet is thrown away.
+			void RequestPath(const GameObject* agent, const Vector3& start, const Vector3& goal, int priority = 0);
+			void CancelRequests(const GameObject* agent);
+
+			bool IsWaiting(const GameObject* agent) const { return latestTickets.count(agent) > 0; }
+
+			// Hand over a finished path if there is one. Returns false if nothing has come back for this agent yet.
+			bool TakeResult(const GameObject* agent, NavigationPath& outPath, bool& found);
+			// The same, but also hands over the rest of a hierarchical route so the next stretches can be expanded as they're needed.
+			bool TakeResult(const GameObject* agent, NavigationPath& outPath, HierarchicalPath& outRoute, bool& found);
+
+			// Call once a frame: collects finished paths, and hands at most the frame budget of new requests to the workers.
+			void Update();
+
+			void SetMaxRequestsPerFrame(int budget) { maxRequestsPerFrame = budget; }
+
+			// Every search collected by the last Update, including any whose agent has since asked for something else- for profiling.
+			const std::vector<NavigationSearchStats>& GetFinishedSearches() const { return finishedSearches; }
+
+		protected:
+			void WorkerLoop(int workerIndex);
+			bool IsLatest(const PathRequest& request) const;
+			bool FindPath(const PathRequest& request, PathResult& result, int workerIndex) const;
+
+			// Main thread only.
+			std::vector<PathRequest> pending;
+			std::map<const GameObject*, unsigned int> latestTickets;
+			std::map<const GameObject*, PathResult> results;
+			unsigned int nextTicket;
+			int maxRequestsPerFrame;
+			std::vector<NavigationSearchStats> finishedSearches;
+
+			// Shared with the workers, guarded by queueMutex.
+			std::deque<PathRequest> workQueue;
+			std::vector<std::pair<const GameObject*, PathResult>> completed;
+			std::map<const GameObject*, unsigned int> dispatchedTickets;
+			int busyWorkers;
+			bool paused;
+			bool shuttingDown;
+
+			mutable std::mutex queueMutex;
+			std::condition_variable workAvailable;
+			std::condition_variable workFinished;
+
+			// The grid is only ever read, so every worker shares it and just keeps its own search scratch.
+			const NavigationGrid* grid;
+			const HierarchicalGrid* hierarchy;
+			mutable std::vector<NavigationSearchContext> workerContexts;
+			mutable std::vector<HierarchicalSearchContext> hierarchyContexts;
+			std::vector<std::thread> workers;
+		};
+	}
+}
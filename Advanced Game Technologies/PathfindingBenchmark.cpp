@@ -0,0 +1,390 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A headless benchmark for the pathfinding, built as its own console project with no renderer or physics.
+Generates levels in the same character format LoadWorldFromFile reads, at a few sizes and obstacle densities, then runs the game's own
+EnemySystem and PathRequestService over them- a crowd of enemies chasing a couple of wandering geese whenever they're carrying something,
+and heading home when they drop it- with each combination of chase and return planners. Reports queries per second, nodes expanded, and
+median/99th percentile query times for the searches the system actually ran, and what the AI cost the main thread each frame.
+Return paths come back from the path service's worker threads, so two runs with the same seed can come out a little differently.
+
+Usage: PathfindingBenchmark [enemies] [simulated seconds] [seed]
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "EnemySystem.h"
+#include "EnemyObject.h"
+#include "GooseObject.h"
+#include "HeldItem.h"
+#include "PathRequestService.h"
+#include "../CSC8503Common/NavigationGrid.h"
+#include "../CSC8503Common/HierarchicalGrid.h"
+#include "../CSC8503Common/FlowField.h"
+#include "../CSC8503Common/PhysicsObject.h"
+#include "../../Common/Assets.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace NCL;
+using namespace CSC8503;
+
+const float SIM_STEP = 1.0f / 60.0f;
+const float STEP_TIME = 0.25f;			// how long it takes to walk one cell
+const float CARRY_TIME = 5.0f;			// how long the geese hold their items each time- the enemies chase for that long
+const float DROPPED_TIME = 5.0f;		// then how long they go without, while the enemies head home
+const int GOOSE_COUNT = 2;
+
+const int NODE_SIZE = 10;
+
+// Same as the game.
+const int CLUSTER_SIZE = 10;
+const int FLOW_FIELD_MIN_CHASERS = 6;
+const float ENEMY_INVERSE_MASS = 0.5f;
+
+// Enemies always chase with their own incremental planner, or the shared flow field once enough are after the same goose.
+// Returns go through the path service, planned over the grid or over the cluster graph for long trips.
+struct Setup
+{
+	const char* name;
+	NavigationGrid::SearchMode returnSearch;
+	bool hierarchy;
+	bool flowField;
+};
+
+const Setup SETUPS[] = {
+	{ "LPA* + A*", NavigationGrid::ASTAR, false, false },
+	{ "LPA* + JPS", NavigationGrid::JUMP_POINT, false, false },
+	{ "LPA* + HPA*", NavigationGrid::ASTAR, true, false },
+	{ "Flow field + HPA*", NavigationGrid::ASTAR, true, true },
+};
+
+struct QueryStats
+{
+	std::vector<float> microseconds;
+	long long nodesExpanded = 0;
+	bool countsNodes = true;
+
+	void Add(float time, int nodes)
+	{
+		microseconds.emplace_back(time);
+		nodesExpanded += nodes;
+	}
+
+	void Add(const NavigationSearchStats& search) { Add(search.milliseconds * 1000.0f, search.nodesExpanded); }
+};
+
+/* LEVEL GENERATION */
+
+// Border of walls, then random obstacles scattered through the middle in the level file characters. Only 'x' and '#' block the grid,
+// the rest are there so the files can be loaded into the game as well.
+void GenerateLevel(const std::string& file, int width, int height, float density, int enemyCount, std::mt19937& random)
+{
+	const char obstacles[] = { 'x', 'x', '#', 'T', 'H' };
+	std::vector<char> cells(width * height, '.');
+	std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			bool border = x == 0 || y == 0 || x == width - 1 || y == height - 1;
+			if (border)
+				cells[y * width + x] = 'x';
+			else if (chance(random) < density)
+				cells[y * width + x] = obstacles[random() % 5];
+			else if (chance(random) < 0.02f)
+				cells[y * width + x] = '~';
+		}
+	}
+
+	cells[(height / 2) * width + width / 2] = 'I';
+
+	for (int placed = 0; placed < enemyCount;)
+	{
+		int cell = (1 + random() % (height - 2)) * width + 1 + random() % (width - 2);
+		if (cells[cell] != '.')
+			continue;
+		cells[cell] = 'E';
+		placed++;
+	}
+
+	std::ofstream outfile(Assets::DATADIR + file);
+	outfile << NODE_SIZE << "\n" << width << "\n" << height << "\n";
+	for (int y = 0; y < height; ++y)
+	{
+		outfile.write(&cells[y * width], width);
+		outfile << "\n";
+	}
+}
+
+// Enemy spawns read back out of the file, same as LoadWorldFromFile would find them.
+std::vector<int> FindEnemies(const std::string& file, int width)
+{
+	std::ifstream infile(Assets::DATADIR + file);
+	std::string line;
+	std::vector<int> enemies;
+
+	for (int i = 0; i < 3; ++i)
+		getline(infile, line);
+
+	for (int y = 0; getline(infile, line); ++y)
+	{
+		for (int x = 0; x < (int)line.size(); ++x)
+		{
+			if (line[x] == 'E')
+				enemies.emplace_back(y * width + x);
+		}
+	}
+	return enemies;
+}
+
+/* SIMULATION */
+
+float ElapsedMicroseconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+Vector3 CellPosition(const NavigationGrid& grid, int cell)
+{
+	return grid.CellToWorld(cell % grid.GetWidth(), cell / grid.GetWidth());
+}
+
+int RandomWalkableCell(const NavigationGrid& grid, std::mt19937& random)
+{
+	while (true)
+	{
+		int x = random() % grid.GetWidth();
+		int y = random() % grid.GetHeight();
+		if (grid.IsWalkable(x, y))
+			return grid.CellIndex(x, y);
+	}
+}
+
+// A goose wandering between random points on the map, a cell at a time.
+struct WanderingGoose
+{
+	GooseObject* object;
+	HeldItem* item;
+	int cell;
+	NavigationPath path;
+	float stepTimer;
+};
+
+// No physics here- each enemy walks at a steady pace whichever way the system pushed it this frame, and slides along anything blocked.
+void MoveEnemy(const NavigationGrid& grid, EnemyObject* enemy, float dt)
+{
+	PhysicsObject* physics = enemy->GetPhysicsObject();
+	Vector3 force = physics->GetForce();
+	physics->ClearForces();
+	force.y = 0;
+	if (force.LengthSquared() <= 0.0f)
+		return;
+
+	Transform& transform = enemy->GetTransform();
+	Vector3 position = transform.GetWorldPosition();
+	Vector3 step = force.Normalised() * (NODE_SIZE / STEP_TIME) * dt;
+
+	const Vector3 moves[3] = { step, Vector3(step.x, 0, 0), Vector3(0, 0, step.z) };
+	for (const Vector3& move : moves)
+	{
+		int x, y;
+		if (grid.WorldToCell(position + move, x, y) && grid.IsWalkable(x, y))
+		{
+			transform.SetWorldPosition(position + move);
+			return;
+		}
+	}
+}
+
+void RunScenario(NavigationGrid& grid, HierarchicalGrid& hierarchy, const Setup& setup, const std::vector<int>& spawns,
+	float seconds, unsigned int seed, QueryStats& chaseStats, QueryStats& returnStats, QueryStats& frameStats)
+{
+	std::mt19937 random(seed);
+	grid.SetSearchMode(setup.returnSearch);
+	frameStats.countsNodes = false;
+
+	// Declared first so it outlives the enemy system, which cancels its requests on the way out.
+	PathRequestService pathService;
+	pathService.SetLevel(&grid, setup.hierarchy ? &hierarchy : nullptr);
+	FlowField field(grid);
+
+	EnemySystem enemyAI(&pathService);
+	enemyAI.SetLevel(&grid, setup.flowField ? &field : nullptr);
+	enemyAI.SetMinFlowFieldChasers(FLOW_FIELD_MIN_CHASERS);
+	// The whole crowd joins every chase, rather than just whoever the geese happen to wander past.
+	enemyAI.SetChaseRadius((float)(std::max(grid.GetWidth(), grid.GetHeight()) * NODE_SIZE * 2));
+
+	std::vector<EnemyObject*> enemies;
+	for (int spawn : spawns)
+	{
+		Vector3 position = CellPosition(grid, spawn);
+		EnemyObject* enemy = new EnemyObject(position);
+		enemy->GetTransform().SetWorldPosition(position);
+		enemy->SetPhysicsObject(new PhysicsObject(&enemy->GetTransform(), enemy->GetBoundingVolume()));
+		enemy->GetPhysicsObject()->SetInverseMass(ENEMY_INVERSE_MASS);
+		enemyAI.AddEnemy(enemy);
+		enemies.emplace_back(enemy);
+	}
+
+	std::vector<WanderingGoose> geese(GOOSE_COUNT);
+	std::vector<GooseObject*> targets;
+	for (int i = 0; i < GOOSE_COUNT; ++i)
+	{
+		WanderingGoose& goose = geese[i];
+		goose.cell = RandomWalkableCell(grid, random);
+		goose.stepTimer = 0.0f;
+		goose.object = new GooseObject("Goose");
+		goose.object->GetTransform().SetWorldPosition(CellPosition(grid, goose.cell));
+		goose.object->SetPhysicsObject(new PhysicsObject(&goose.object->GetTransform(), goose.object->GetBoundingVolume()));
+		goose.item = new HeldItem("Apple", 1, CellPosition(grid, goose.cell), i);
+		goose.item->SetPhysicsObject(new PhysicsObject(&goose.item->GetTransform(), goose.item->GetBoundingVolume()));
+		targets.emplace_back(goose.object);
+	}
+	enemyAI.SetTargets(targets);
+
+	NavigationSearchContext gooseContext;
+	for (float time = 0.0f; time < seconds; time += SIM_STEP)
+	{
+		bool carrying = fmodf(time, CARRY_TIME + DROPPED_TIME) < CARRY_TIME;
+		for (WanderingGoose& goose : geese)
+		{
+			if (carrying && !goose.object->IsHoldingItem())
+				goose.object->PickUpItem(goose.item);
+			else if (!carrying && goose.object->IsHoldingItem())
+				goose.object->DropHeldItem();
+
+			goose.stepTimer += SIM_STEP;
+			if (goose.stepTimer < STEP_TIME)
+				continue;
+			goose.stepTimer = 0.0f;
+
+			Vector3 waypoint;
+			if (!goose.path.PopWaypoint(waypoint))
+				grid.FindPath(CellPosition(grid, goose.cell), CellPosition(grid, RandomWalkableCell(grid, random)), goose.path, gooseContext);
+			else
+			{
+				int x, y;
+				grid.WorldToCell(waypoint, x, y);
+				goose.cell = grid.CellIndex(x, y);
+				goose.object->GetTransform().SetWorldPosition(CellPosition(grid, goose.cell));
+			}
+		}
+
+		// The same calls in the same order as the game's frame, then the physics step.
+		auto start = std::chrono::high_resolution_clock::now();
+		pathService.Update();
+		enemyAI.Update(SIM_STEP);
+		frameStats.Add(ElapsedMicroseconds(start), 0);
+
+		for (const NavigationSearchStats& search : enemyAI.GetChaseSearches())
+			chaseStats.Add(search);
+		for (const NavigationSearchStats& search : pathService.GetFinishedSearches())
+			returnStats.Add(search);
+
+		for (EnemyObject* enemy : enemies)
+			MoveEnemy(grid, enemy, SIM_STEP);
+	}
+
+	enemyAI.Clear();
+	for (EnemyObject* enemy : enemies)
+		delete enemy;
+	for (WanderingGoose& goose : geese)
+	{
+		if (goose.object->IsHoldingItem())
+			goose.object->DropHeldItem();
+		delete goose.item;
+		delete goose.object;
+	}
+}
+
+/* REPORTING */
+
+float Percentile(std::vector<float>& values, float percentile)
+{
+	if (values.empty())
+		return 0.0f;
+	size_t index = std::min<size_t>(values.size() - 1, (size_t)(percentile * values.size()));
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+void Report(const char* planner, const char* kind, QueryStats& stats)
+{
+	double total = 0.0;
+	for (float time : stats.microseconds)
+		total += time;
+
+	size_t count = stats.microseconds.size();
+	double queriesPerSecond = total > 0.0 ? count / (total / 1000000.0) : 0.0;
+
+	char nodes[32] = "-";
+	if (stats.countsNodes && count > 0)
+		snprintf(nodes, sizeof(nodes), "%.1f", (double)stats.nodesExpanded / count);
+
+	float p50 = Percentile(stats.microseconds, 0.5f);
+	float p99 = Percentile(stats.microseconds, 0.99f);
+
+	printf("  %-18s %-7s %9zu %12.0f %10s %10.1f %10.1f\n", planner, kind, count, queriesPerSecond, nodes, p50, p99);
+}
+
+int main(int argc, char** argv)
+{
+	int enemyCount = argc > 1 ? atoi(argv[1]) : 50;
+	float seconds = argc > 2 ? (float)atof(argv[2]) : 30.0f;
+	unsigned int seed = argc > 3 ? (unsigned int)atoi(argv[3]) : 1;
+
+	const int sizes[] = { 50, 100, 200, 400 };
+	const float densities[] = { 0.1f, 0.25f };
+
+	printf("%d enemies, %.0f simulated seconds per run, seed %u\n", enemyCount, seconds, seed);
+
+	for (int size : sizes)
+	{
+		for (float density : densities)
+		{
+			std::mt19937 random(seed);
+			std::string file = "Benchmark" + std::to_string(size) + "_" + std::to_string((int)(density * 100)) + ".txt";
+			GenerateLevel(file, size, size, density, enemyCount, random);
+
+			auto loadStart = std::chrono::high_resolution_clock::now();
+			NavigationGrid grid(file);
+			float gridLoad = ElapsedMicroseconds(loadStart) / 1000.0f;
+
+			auto hierarchyStart = std::chrono::high_resolution_clock::now();
+			HierarchicalGrid hierarchy(grid, CLUSTER_SIZE);
+			float hierarchyBuild = ElapsedMicroseconds(hierarchyStart) / 1000.0f;
+
+			std::vector<int> spawns = FindEnemies(file, size);
+
+			printf("\n%dx%d, %.0f%% obstacles (grid load %.2fms, HPA* build %.2fms, %d entrances)\n",
+				size, size, density * 100.0f, gridLoad, hierarchyBuild, hierarchy.GetNodeCount());
+			printf("  %-18s %-7s %9s %12s %10s %10s %10s\n", "planner", "query", "queries", "queries/s", "nodes", "p50 (us)", "p99 (us)");
+
+			for (const Setup& setup : SETUPS)
+			{
+				QueryStats chaseStats;
+				QueryStats returnStats;
+				QueryStats frameStats;
+				RunScenario(grid, hierarchy, setup, spawns, seconds, seed, chaseStats, returnStats, frameStats);
+
+				Report(setup.name, "chase", chaseStats);
+				Report(setup.name, "return", returnStats);
+				// One "query" per frame here- the path service and enemy system updates together.
+				Report(setup.name, "frame", frameStats);
+			}
+		}
+	}
+
+	return 0;
+}
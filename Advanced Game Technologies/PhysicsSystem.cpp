@@ -2,7 +2,10 @@
 #include "PhysicsObject.h"
 #include "GameObject.h"
 #include "CollisionDetection.h"
+#include "RigidBodyState.h"
+#include "ContactManifold.h"
 #include "../../Common/Quaternion.h"
+#include "../../Common/Maths.h"
 
 /* Only a selection of functions of the physics system are given as example here to demonstrate the broadphase extension and additional collision resolution. */
 #include "Constraint.h"
@@ -10,9 +13,260 @@
 #include "Debug.h"
 
 #include <functional>
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
 using namespace NCL;
 using namespace CSC8503;
 
+PhysicsSystem::PhysicsSystem(GameWorld& g) : gameWorld(g) {
+	applyGravity = false;
+	useBroadPhase = false;
+	useContinuousCollision = false;
+	dynamicTreeStale = true;
+	accumulatedForceTime = 0.0f;
+	dTOffset = 0.0f;
+	globalDamping = 0.95f;
+	SetGravity(Vector3(0.0f, -9.8f, 0.0f));
+
+	fixedDeltaTime = 1.0f / 120.0f;
+	maxSubsteps = 8;
+
+	solverIterations = 10;
+	contactFriction = 0.4f;
+
+	// Everything collides with everything until told otherwise.
+	for (int i = 0; i < MAX_COLLISION_LAYERS; ++i)
+		layerMatrix[i] = ~0u;
+}
+
+// Turn collisions between two layers on or off. The matrix is kept symmetric so pair order never matters.
+void PhysicsSystem::SetLayerInteraction(int layerA, int layerB, bool interacts)
+{
+	if (interacts)
+	{
+		layerMatrix[layerA] |= (1u << layerB);
+		layerMatrix[layerB] |= (1u << layerA);
+	}
+	else
+	{
+		layerMatrix[layerA] &= ~(1u << layerB);
+		layerMatrix[layerB] &= ~(1u << layerA);
+	}
+}
+
+// Cheap rejection done during quadtree traversal, before a pair is ever added to the broadphase set.
+bool PhysicsSystem::CanCollide(const GameObject* a, const GameObject* b) const
+{
+	// Static objects never move, so they can't start colliding with each other.
+	if (a->IsStatic() && b->IsStatic())
+		return false;
+
+	if ((layerMatrix[a->GetCollisionLayer()] & (1u << b->GetCollisionLayer())) == 0)
+		return false;
+
+	// No shared resolution type means there would be nothing to do with the collision even if it happened.
+	if (((int)a->GetPhysicsObject()->GetCollisionType() & (int)b->GetPhysicsObject()->GetCollisionType()) == 0)
+		return false;
+
+	return true;
+}
+
+/*
+Steps the simulation in fixed size chunks regardless of the frame rate, so the results (and the cost) of a second of physics are always the same.
+Any time left over is carried into the next frame, and rendering gets transforms blended between the last two steps to hide the difference.
+*/
+void PhysicsSystem::Update(float dt) {
+	// Put the real simulated poses back before stepping- last frame only handed the renderer blended ones.
+	RestoreSimulatedTransforms();
+
+	dTOffset += dt; // We accumulate time delta here- there might be remainders from previous frame!
+
+	// Gameplay adds its forces once a render frame, however many steps that frame ends up running (if any).
+	AccumulateForces(dt);
+
+	// Spiral of death guard: if a frame took so long the physics can't catch up within the step limit, drop the excess time rather than trying to.
+	float maxFrameTime = fixedDeltaTime * maxSubsteps;
+	if (dTOffset > maxFrameTime)
+		dTOffset = maxFrameTime;
+
+	int constraintIterationCount = 10;
+	int steps = 0;
+
+	if (dTOffset >= fixedDeltaTime)
+		ApplyAccumulatedForces();
+
+	while (dTOffset >= fixedDeltaTime)
+	{
+		StorePreviousStepPoses();
+
+		if (useBroadPhase)
+			UpdateObjectAABBs();
+
+		IntegrateAccel(fixedDeltaTime); // Update accelerations from external forces
+		if (useBroadPhase)
+		{
+			BroadPhase();
+			NarrowPhase();
+		}
+		else
+		{
+			BasicCollisionDetection();
+		}
+
+		SolveContacts(fixedDeltaTime);
+
+		float constraintDt = fixedDeltaTime / (float)constraintIterationCount;
+		for (int i = 0; i < constraintIterationCount; ++i)
+			UpdateConstraints(constraintDt);
+
+		IntegrateVelocity(fixedDeltaTime); // Update positions from new velocity changes
+		// Without the broadphase nothing rebuilds the dynamic tree, so queries have to do it themselves.
+		if (!useBroadPhase)
+			dynamicTreeStale = true;
+
+		dTOffset -= fixedDeltaTime;
+		steps++;
+	}
+
+	if (steps > 0)
+	{
+		ClearForces();
+		UpdateCollisionList(); // Remove any old collisions
+	}
+
+	InterpolateTransforms(dTOffset / fixedDeltaTime);
+}
+
+void PhysicsSystem::SetFixedTimestep(float stepLength)
+{
+	// A step that never uses any time up would never let Update finish.
+	if (stepLength <= 0.0f)
+		return;
+	fixedDeltaTime = stepLength;
+}
+
+/*
+Each frame's forces are taken off the bodies and kept as the impulse they'd give over that frame, until a frame comes along that runs a step.
+Every step in it then gets the impulse spread back out as an average force over all the time it was built up in- so a force added every frame
+pushes just as hard at 144fps as at 60, rather than a few frames' worth piling up into one step.
+*/
+void PhysicsSystem::AccumulateForces(float dt)
+{
+	accumulatedImpulses.resize(dynamicObjects.size());
+	accumulatedForceTime += dt;
+
+	for (size_t i = 0; i < dynamicObjects.size(); ++i)
+	{
+		PhysicsObject* object = dynamicObjects[i]->GetPhysicsObject();
+		if (!object)
+			continue;
+
+		accumulatedImpulses[i].linear += object->GetForce() * dt;
+		accumulatedImpulses[i].angular += object->GetTorque() * dt;
+		object->ClearForces();
+	}
+}
+
+void PhysicsSystem::ApplyAccumulatedForces()
+{
+	if (accumulatedForceTime > 0.0f)
+	{
+		float invTime = 1.0f / accumulatedForceTime;
+		for (size_t i = 0; i < dynamicObjects.size(); ++i)
+		{
+			PhysicsObject* object = dynamicObjects[i]->GetPhysicsObject();
+			if (!object)
+				continue;
+
+			object->AddForce(accumulatedImpulses[i].linear * invTime);
+			object->AddTorque(accumulatedImpulses[i].angular * invTime);
+		}
+	}
+
+	accumulatedImpulses.assign(dynamicObjects.size(), AccumulatedImpulse());
+	accumulatedForceTime = 0.0f;
+}
+
+void PhysicsSystem::SetMaxSubsteps(int steps)
+{
+	maxSubsteps = max(steps, 1);
+}
+
+void PhysicsSystem::SetSolverIterations(int iterations)
+{
+	solverIterations = max(iterations, 1);
+}
+
+// Take a copy of where every dynamic object is before a step is run, as the starting point for render interpolation.
+void PhysicsSystem::StorePreviousStepPoses()
+{
+	interpolatedPoses.resize(dynamicObjects.size());
+
+	for (size_t i = 0; i < dynamicObjects.size(); ++i)
+	{
+		InterpolatedPose& pose = interpolatedPoses[i];
+		pose.object = dynamicObjects[i];
+		pose.previousPosition = dynamicObjects[i]->GetTransform().GetWorldPosition();
+		pose.previousOrientation = dynamicObjects[i]->GetTransform().GetLocalOrientation();
+	}
+}
+
+// Blend every dynamic object between its pose before and after the last step, by how far into the next step we already are.
+void PhysicsSystem::InterpolateTransforms(float alpha)
+{
+	for (InterpolatedPose& pose : interpolatedPoses)
+	{
+		Transform& transform = pose.object->GetTransform();
+
+		pose.simulatedPosition = transform.GetWorldPosition();
+		pose.simulatedOrientation = transform.GetLocalOrientation();
+
+		// Sleeping objects aren't going anywhere.
+		if (pose.object->IsSleeping())
+		{
+			pose.renderedPosition = pose.simulatedPosition;
+			pose.renderedOrientation = pose.simulatedOrientation;
+			continue;
+		}
+
+		pose.renderedPosition = pose.previousPosition + (pose.simulatedPosition - pose.previousPosition) * alpha;
+		pose.renderedOrientation = Quaternion::Slerp(pose.previousOrientation, pose.simulatedOrientation, alpha);
+
+		transform.SetLocalPosition(pose.renderedPosition);
+		transform.SetWorldPosition(pose.renderedPosition);
+		transform.SetLocalOrientation(pose.renderedOrientation);
+	}
+}
+
+namespace {
+	bool SameOrientation(const Quaternion& a, const Quaternion& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+	}
+}
+
+// Undo the render interpolation, unless gameplay has since moved or turned the object itself (held items, snapshots, reconciling etc).
+// Position and orientation are checked separately, so setting just one doesn't lose the other.
+void PhysicsSystem::RestoreSimulatedTransforms()
+{
+	for (InterpolatedPose& pose : interpolatedPoses)
+	{
+		Transform& transform = pose.object->GetTransform();
+		if (transform.GetWorldPosition() == pose.renderedPosition)
+		{
+			transform.SetLocalPosition(pose.simulatedPosition);
+			transform.SetWorldPosition(pose.simulatedPosition);
+		}
+
+		if (SameOrientation(transform.GetLocalOrientation(), pose.renderedOrientation))
+			transform.SetLocalOrientation(pose.simulatedOrientation);
+		// Turned by gameplay, so the world space tensor's for an orientation it doesn't have any more.
+		else if (pose.object->GetPhysicsObject())
+			pose.object->GetPhysicsObject()->UpdateInertiaTensor();
+	}
+}
+
 // Build up the sets of dynamic and static objects.
 void PhysicsSystem::SetupQuadtree()
 {
@@ -23,6 +277,15 @@ void PhysicsSystem::SetupQuadtree()
 	UpdateObjectAABBs();
 
 	staticTree.SetParams(Vector2(1024, 1024), 7, 6);
+	dynamicTreeStale = true;
+
+	// Clear out the integration and interpolation state too, so they can't hold on to objects from the last scene.
+	bodyState.Clear();
+	interpolatedPoses.clear();
+	manifolds.clear();
+	accumulatedImpulses.clear();
+	accumulatedForceTime = 0.0f;
+	dTOffset = 0.0f;
 
 	// Iterate through all objects to create static tree and list of dynamic objects
 	std::vector<GameObject*>::const_iterator first;
@@ -33,6 +296,10 @@ void PhysicsSystem::SetupQuadtree()
 	// Iterate through all game objects to insert them into the tree or the dynamic object vector depending on what they're marked as.
 	for (auto i = first; i != last; ++i)
 	{
+		// Integration only rebuilds inertia tensors when an orientation changes, so make sure every tensor starts off correct.
+		if ((*i)->GetPhysicsObject())
+			(*i)->GetPhysicsObject()->UpdateInertiaTensor();
+
 		Vector3 halfSizes;
 		if (!(*i)->GetBroadphaseAABB(halfSizes))
 			continue;
@@ -50,22 +317,29 @@ void PhysicsSystem::SetupQuadtree()
 }
 
 
-// Builds a dynamic quadtree every frame- still a collision acceleration as static objects left alone!
-void PhysicsSystem::DynamicVersusDynamic() {
-	QuadTree<GameObject*> dynamicTree(Vector2(1024, 1024), 7, 6);
+// Builds a dynamic quadtree every step- still a collision acceleration as static objects left alone!
+// Kept until the next step so queries like RaycastNearby can use it too.
+void PhysicsSystem::BuildDynamicTree()
+{
+	dynamicTree.SetParams(Vector2(1024, 1024), 7, 6);
 
 	std::vector<GameObject*>::const_iterator first = dynamicObjects.begin();
 	std::vector<GameObject*>::const_iterator last = dynamicObjects.end();
 
 	for (auto i = first; i != last; ++i)
 	{
+		Vector3 pos;
 		Vector3 halfSizes;
-		if (!(*i)->GetBroadphaseAABB(halfSizes))
+		if (!GetSweptBroadphaseAABB(*i, pos, halfSizes))
 			continue;
 
-		Vector3 pos = (*i)->GetConstTransform().GetWorldPosition();
 		dynamicTree.Insert(*i, pos, halfSizes);
 	}
+	dynamicTreeStale = false;
+}
+
+void PhysicsSystem::DynamicVersusDynamic() {
+	BuildDynamicTree();
 
 	dynamicTree.OperateOnContents(
 		[&](std::list<QuadTreeEntry<GameObject*>>& data) {
@@ -74,6 +348,9 @@ void PhysicsSystem::DynamicVersusDynamic() {
 			{
 				for (auto j = std::next(i); j != data.end(); ++j)
 				{
+					if (!CanCollide((*i).object, (*j).object))
+						continue;
+
 					info.a = min((*i).object, (*j).object);
 					info.b = max((*i).object, (*j).object);
 					broadphaseCollisions.insert(info);
@@ -83,6 +360,7 @@ void PhysicsSystem::DynamicVersusDynamic() {
 	);
 }
 
+// Single contact, single pass resolution- still used by the basic collision detection path, the broadphase path goes through SolveContacts.
 void PhysicsSystem::ImpulseResolveCollision(GameObject& a, GameObject& b, CollisionDetection::ContactPoint& p) const {
 
 	PhysicsObject* physA = a.GetPhysicsObject();
@@ -175,17 +453,19 @@ void PhysicsSystem::BroadPhase() {
 	for (auto i = first; i != last; ++i)
 	{
 
+		Vector3 pos;
 		Vector3 halfSizes;
-		if (!(*i)->GetBroadphaseAABB(halfSizes))
+		if (!GetSweptBroadphaseAABB(*i, pos, halfSizes))
 			continue;
 
-		Vector3 pos = (*i)->GetConstTransform().GetWorldPosition();
-
 		staticTree.DynamicObjectComparison([&](std::list<QuadTreeEntry<GameObject*>>& data)
 			{
 				CollisionDetection::CollisionInfo info;
 				for (auto j = data.begin(); j != data.end(); ++j)
 				{
+					if (!CanCollide((*j).object, *i))
+						continue;
+
 					// is this pair of items already in the collision set-
 					// if the same pair is in another quadtree node together etc
 					info.a = min((*j).object, (*i));
@@ -197,13 +477,290 @@ void PhysicsSystem::BroadPhase() {
 	}
 }
 
+/*
+A short ray against just the objects on the given layers, found from the broadphase trees rather than by testing every object in the world.
+Only the tree nodes the ray's box passes through are looked at, and everything in them on the wrong layer is skipped before the ray test.
+The dynamic tree's from the last step, which is close enough for anything that isn't flying across the world.
+*/
+bool PhysicsSystem::RaycastNearby(const Ray& r, RayCollision& closestCollision, float maxDistance, unsigned int layerMask, const GameObject* ignore)
+{
+	if (dynamicTreeStale)
+		BuildDynamicTree();
+
+	Vector3 start = r.GetPosition();
+	Vector3 end = start + r.GetDirection() * maxDistance;
+	Vector3 pos = (start + end) * 0.5f;
+	Vector3 delta = end - start;
+	Vector3 halfSizes = Vector3(fabs(delta.x), fabs(delta.y), fabs(delta.z)) * 0.5f;
+
+	GameObject* closest = nullptr;
+	auto testNode = [&](std::list<QuadTreeEntry<GameObject*>>& data)
+	{
+		for (auto i = data.begin(); i != data.end(); ++i)
+		{
+			GameObject* object = (*i).object;
+			if (object == ignore || (layerMask & (1u << object->GetCollisionLayer())) == 0)
+				continue;
+
+			RayCollision collision;
+			if (!CollisionDetection::RayIntersection(r, *object, collision) || collision.rayDistance > maxDistance)
+				continue;
+
+			if (!closest || collision.rayDistance < closestCollision.rayDistance)
+			{
+				closest = object;
+				closestCollision = collision;
+				closestCollision.node = object;
+			}
+		}
+	};
+
+	// Taken down the trees the same way a dynamic object is in the broadphase, just with the ray's box.
+	GameObject* querying = const_cast<GameObject*>(ignore);
+	staticTree.DynamicObjectComparison(testNode, querying, pos, halfSizes);
+	dynamicTree.DynamicObjectComparison(testNode, querying, pos, halfSizes);
+
+	return closest != nullptr;
+}
+
+/* CONTINUOUS COLLISION DETECTION */
+
+namespace {
+	// Sweep a point from start along delta against a box centred at the origin. Returns the fraction of delta travelled at first contact.
+	bool SweepPointAgainstBox(const Vector3& start, const Vector3& delta, const Vector3& halfSizes, float& toi, Vector3& normal)
+	{
+		float entry = 0.0f;
+		float exit = 1.0f;
+		int entryAxis = -1;
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float s = start[axis];
+			float d = delta[axis];
+			float h = halfSizes[axis];
+
+			if (fabs(d) < 1e-6f)
+			{
+				// Not moving on this axis, so it has to already be inside the slab.
+				if (s < -h || s > h)
+					return false;
+				continue;
+			}
+
+			float t1 = (-h - s) / d;
+			float t2 = (h - s) / d;
+			if (t1 > t2)
+				std::swap(t1, t2);
+
+			if (t1 > entry)
+			{
+				entry = t1;
+				entryAxis = axis;
+			}
+			exit = min(exit, t2);
+
+			if (entry > exit)
+				return false;
+		}
+
+		// Started inside the box- the discrete test already deals with that.
+		if (entryAxis < 0)
+			return false;
+
+		toi = entry;
+		normal = Vector3(0, 0, 0);
+		normal[entryAxis] = delta[entryAxis] > 0 ? -1.0f : 1.0f;
+		return true;
+	}
+
+	// Sweep a point from start along delta against a sphere centred at the origin.
+	bool SweepPointAgainstSphere(const Vector3& start, const Vector3& delta, float radius, float& toi, Vector3& normal)
+	{
+		float a = Vector3::Dot(delta, delta);
+		float b = Vector3::Dot(start, delta);
+		float c = Vector3::Dot(start, start) - radius * radius;
+
+		// Already overlapping, or not moving towards it.
+		if (c <= 0.0f || b >= 0.0f || a < 1e-12f)
+			return false;
+
+		float discriminant = b * b - a * c;
+		if (discriminant < 0.0f)
+			return false;
+
+		float t = (-b - sqrtf(discriminant)) / a;
+		if (t < 0.0f || t > 1.0f)
+			return false;
+
+		toi = t;
+		normal = (start + delta * t).Normalised();
+		return true;
+	}
+}
+
+// Swept shapes are inflated rather than exact Minkowski sums, so spheres sweep exactly against spheres and everything else is treated as its bounding box.
+bool PhysicsSystem::SweepVolumes(const CollisionVolume& moving, const Vector3& movingHalfSizes, const Vector3& start, const Vector3& delta,
+	const GameObject& other, const Vector3& otherPos, float& toi, Vector3& normal) const
+{
+	const CollisionVolume* otherVolume = other.GetBoundingVolume();
+	Vector3 localStart = start - otherPos;
+
+	float movingRadius = moving.type == VolumeType::Sphere ? ((const SphereVolume&)moving).GetRadius() : movingHalfSizes.Length();
+
+	switch (otherVolume->type)
+	{
+	case VolumeType::Sphere:
+	{
+		float radius = ((const SphereVolume*)otherVolume)->GetRadius();
+		if (moving.type == VolumeType::Sphere)
+			return SweepPointAgainstSphere(localStart, delta, radius + movingRadius, toi, normal);
+		return SweepPointAgainstBox(localStart, delta, movingHalfSizes + Vector3(radius, radius, radius), toi, normal);
+	}
+	case VolumeType::AABB:
+	{
+		Vector3 inflate = moving.type == VolumeType::Sphere ? Vector3(movingRadius, movingRadius, movingRadius) : movingHalfSizes;
+		return SweepPointAgainstBox(localStart, delta, ((const AABBVolume*)otherVolume)->GetHalfDimensions() + inflate, toi, normal);
+	}
+	case VolumeType::OBB:
+	{
+		// Do the sweep in the box's own space, then rotate the normal back out again.
+		Quaternion orientation = other.GetConstTransform().GetWorldOrientation();
+		Quaternion invOrientation = orientation.Conjugate();
+
+		Vector3 inflate = Vector3(movingRadius, movingRadius, movingRadius);
+		if (!SweepPointAgainstBox(invOrientation * localStart, invOrientation * delta, ((const OBBVolume*)otherVolume)->GetHalfDimensions() + inflate, toi, normal))
+			return false;
+
+		normal = orientation * normal;
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+// Where the body was at the start of last step, as far as sweeping goes. Something put somewhere directly (a reset, a respawn) rather
+// than moved there by its velocity hasn't really travelled the path in between, so it's treated as if it hadn't moved at all- sweeping
+// that jump would find hits along a path it never took.
+Vector3 PhysicsSystem::GetSweepStart(const GameObject& object) const
+{
+	Vector3 position = object.GetConstTransform().GetWorldPosition();
+	if (object.IsStatic() || !object.GetPhysicsObject())
+		return position;
+
+	Vector3 halfSizes;
+	object.GetBroadphaseAABB(halfSizes);
+	float smallestExtent = min(halfSizes.x, min(halfSizes.y, halfSizes.z));
+
+	// Twice what its velocity accounts for, with a bit over for contacts pushing it apart.
+	Vector3 moved = position - object.GetPreviousPosition();
+	float possible = object.GetPhysicsObject()->GetLinearVelocity().Length() * fixedDeltaTime * 2.0f + smallestExtent;
+	if (moved.LengthSquared() > possible * possible)
+		return position;
+
+	return object.GetPreviousPosition();
+}
+
+// Only bodies that moved further than half their own size last step can have skipped over something.
+bool PhysicsSystem::IsFastMoving(const GameObject& object) const
+{
+	if (object.IsStatic() || object.IsSleeping() || !object.GetPhysicsObject())
+		return false;
+
+	Vector3 halfSizes;
+	if (!object.GetBroadphaseAABB(halfSizes))
+		return false;
+
+	float smallestExtent = min(halfSizes.x, min(halfSizes.y, halfSizes.z));
+	Vector3 moved = object.GetConstTransform().GetWorldPosition() - GetSweepStart(object);
+
+	return moved.LengthSquared() > (smallestExtent * smallestExtent * 0.25f);
+}
+
+// Fast bodies get their broadphase box stretched over the whole of last step's movement, so the pair still reaches the narrowphase.
+bool PhysicsSystem::GetSweptBroadphaseAABB(const GameObject* object, Vector3& pos, Vector3& halfSizes) const
+{
+	if (!object->GetBroadphaseAABB(halfSizes))
+		return false;
+
+	pos = object->GetConstTransform().GetWorldPosition();
+
+	if (useContinuousCollision && IsFastMoving(*object))
+	{
+		Vector3 previous = GetSweepStart(*object);
+		Vector3 delta = pos - previous;
+
+		pos = previous + delta * 0.5f;
+		halfSizes += Vector3(fabs(delta.x), fabs(delta.y), fabs(delta.z)) * 0.5f;
+	}
+
+	return true;
+}
+
+// Time of impact test for a pair that isn't intersecting now but may have passed through each other during the last step.
+// On a hit both objects are wound back to the moment of contact and a zero penetration contact point is added for resolution.
+bool PhysicsSystem::SweptIntersection(CollisionDetection::CollisionInfo& info)
+{
+	GameObject* a = info.a;
+	GameObject* b = info.b;
+
+	bool fastA = IsFastMoving(*a);
+	bool fastB = IsFastMoving(*b);
+	if (!fastA && !fastB)
+		return false;
+
+	// Sweep whichever is moving fastest against the other, using motion relative to it.
+	if (!fastA || (fastB && (b->GetConstTransform().GetWorldPosition() - GetSweepStart(*b)).LengthSquared() >
+		(a->GetConstTransform().GetWorldPosition() - GetSweepStart(*a)).LengthSquared()))
+	{
+		std::swap(a, b);
+	}
+
+	Vector3 previousA = GetSweepStart(*a);
+	Vector3 previousB = GetSweepStart(*b);
+	Vector3 deltaA = a->GetConstTransform().GetWorldPosition() - previousA;
+	Vector3 deltaB = b->GetConstTransform().GetWorldPosition() - previousB;
+
+	Vector3 halfSizesA;
+	a->GetBroadphaseAABB(halfSizesA);
+
+	float toi;
+	Vector3 surfaceNormal;
+	if (!SweepVolumes(*a->GetBoundingVolume(), halfSizesA, previousA, deltaA - deltaB, *b, previousB, toi, surfaceNormal))
+		return false;
+
+	Vector3 contactA = previousA + deltaA * toi;
+	Vector3 contactB = previousB + deltaB * toi;
+
+	a->GetTransform().SetWorldPosition(contactA);
+	a->GetTransform().SetLocalPosition(contactA);
+	if (!b->IsStatic())
+	{
+		b->GetTransform().SetWorldPosition(contactB);
+		b->GetTransform().SetLocalPosition(contactB);
+	}
+
+	// Surface normal points from b out towards a, but contact normals go from info.a to info.b.
+	Vector3 normal = (a == info.a) ? -surfaceNormal : surfaceNormal;
+
+	float radiusA = a->GetBoundingVolume()->type == VolumeType::Sphere ? ((const SphereVolume*)a->GetBoundingVolume())->GetRadius() : 0.0f;
+	Vector3 contactPoint = contactA - surfaceNormal * radiusA;
+
+	Vector3 localA = contactPoint - info.a->GetConstTransform().GetWorldPosition();
+	Vector3 localB = contactPoint - info.b->GetConstTransform().GetWorldPosition();
+	info.AddContactPoint(localA, localB, normal, 0.0f);
+
+	return true;
+}
+
 void PhysicsSystem::NarrowPhase() {
 	// Iterate through all collisions added to the list, and if the two collision volumes are actually intersecting, resolve the collision
 	for (std::set<CollisionDetection::CollisionInfo>::iterator i = broadphaseCollisions.begin(); i != broadphaseCollisions.end(); ++i)
 	{
 		CollisionDetection::CollisionInfo info = *i;
 	
-		if (CollisionDetection::ObjectIntersection(info.a, info.b, info))
+		// Fast bodies that passed straight through something last step won't be intersecting anymore, so fall back to a sweep for those.
+		if (CollisionDetection::ObjectIntersection(info.a, info.b, info) || (useContinuousCollision && SweptIntersection(info)))
 		{
 			
 			info.framesLeft = numCollisionFrames;
@@ -211,9 +768,11 @@ void PhysicsSystem::NarrowPhase() {
 			// Determine what type of resolutions to use between these objects.
 			CollisionType pairType = (CollisionType)((int)info.a->GetPhysicsObject()->GetCollisionType() & (int)info.b->GetPhysicsObject()->GetCollisionType());
 
+			// Impulse contacts are gathered up into their pair's manifold, and solved all together once every pair is known.
 			if (pairType == CollisionType::IMPULSE)
 			{
-				ImpulseResolveCollision(*info.a, *info.b, info.point);
+				auto manifold = manifolds.emplace(ManifoldKey(info.a, info.b), ContactManifold(info.a, info.b)).first;
+				manifold->second.AddContact(*info.a, *info.b, info.point);
 			}
 
 			if (pairType == CollisionType::SPRING)
@@ -221,113 +780,422 @@ void PhysicsSystem::NarrowPhase() {
 				ResolveSpringCollision(*info.a, *info.b, info.point);
 			}
 
-			allCollisions.insert(info); // insert into our main set
+			auto inserted = allCollisions.insert(info); // insert into our main set
+
+			// Still touching, so keep it (and its manifold) alive- without resetting to a fresh collision that would fire OnCollisionBegin again.
+			if (!inserted.second && inserted.first->framesLeft < numCollisionFrames)
+				inserted.first->framesLeft = numCollisionFrames - 1;
 		}
 	}
 }
 
-void PhysicsSystem::IntegrateAccel(float dt) {
+/* CONTACT SOLVER */
+
+std::pair<GameObject*, GameObject*> PhysicsSystem::ManifoldKey(GameObject* a, GameObject* b)
+{
+	return std::make_pair(min(a, b), max(a, b));
+}
+
+void PhysicsSystem::UpdateCollisionList() {
+	for (std::set<CollisionDetection::CollisionInfo>::iterator i = allCollisions.begin(); i != allCollisions.end(); )
+	{
+		if ((*i).framesLeft == numCollisionFrames)
+		{
+			i->a->OnCollisionBegin(i->b);
+			i->b->OnCollisionBegin(i->a);
+		}
+		(*i).framesLeft = (*i).framesLeft - 1;
+		if ((*i).framesLeft < 0)
+		{
+			i->a->OnCollisionEnd(i->b);
+			i->b->OnCollisionEnd(i->a);
+			// The pair has stopped touching, so its cached contacts (and their impulses) are no use anymore.
+			manifolds.erase(ManifoldKey(i->a, i->b));
+			i = allCollisions.erase(i);
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+// Set up each manifold point for this step, then apply last frame's impulses straight away so the iterations start close to the answer.
+void PhysicsSystem::PrepareContacts(float dt)
+{
+	// Allow a little overlap before correcting it, and only remove a fraction of the rest each step- stops resting contacts jittering.
+	const float allowedPenetration = 0.01f;
+	const float biasFactor = 0.2f;
+	// Don't bother bouncing below this speed, otherwise stacks never settle.
+	const float restitutionThreshold = 1.0f;
+
+	for (auto m = manifolds.begin(); m != manifolds.end(); ++m)
+	{
+		ContactManifold& manifold = m->second;
+		manifold.Refresh();
+
+		PhysicsObject* physA = manifold.GetObjectA()->GetPhysicsObject();
+		PhysicsObject* physB = manifold.GetObjectB()->GetPhysicsObject();
+		const Transform& transformA = manifold.GetObjectA()->GetConstTransform();
+		const Transform& transformB = manifold.GetObjectB()->GetConstTransform();
+
+		float totalMass = physA->GetInverseMass() + physB->GetInverseMass();
+		float cRestitution = physA->GetElasticity() * physB->GetElasticity();
+
+		for (int i = 0; i < manifold.GetNumPoints(); ++i)
+		{
+			ManifoldPoint& p = manifold.GetPoint(i);
+
+			p.relativeA = transformA.GetWorldOrientation() * p.localA;
+			p.relativeB = transformB.GetWorldOrientation() * p.localB;
+
+			// Any two directions at right angles to the normal will do for friction.
+			Vector3 helper = fabs(p.normal.x) > 0.9f ? Vector3(0, 1, 0) : Vector3(1, 0, 0);
+			p.tangents[0] = Vector3::Cross(p.normal, helper).Normalised();
+			p.tangents[1] = Vector3::Cross(p.normal, p.tangents[0]);
+
+			// Same inertia effect as ImpulseResolveCollision, worked out once per direction.
+			Vector3 inertiaA = Vector3::Cross(physA->GetInertiaTensor() * Vector3::Cross(p.relativeA, p.normal), p.relativeA);
+			Vector3 inertiaB = Vector3::Cross(physB->GetInertiaTensor() * Vector3::Cross(p.relativeB, p.normal), p.relativeB);
+			float normalEffect = totalMass + Vector3::Dot(inertiaA + inertiaB, p.normal);
+			p.normalMass = normalEffect > 0.0f ? 1.0f / normalEffect : 0.0f;
+
+			for (int t = 0; t < 2; ++t)
+			{
+				Vector3 tInertiaA = Vector3::Cross(physA->GetInertiaTensor() * Vector3::Cross(p.relativeA, p.tangents[t]), p.relativeA);
+				Vector3 tInertiaB = Vector3::Cross(physB->GetInertiaTensor() * Vector3::Cross(p.relativeB, p.tangents[t]), p.relativeB);
+				float tangentEffect = totalMass + Vector3::Dot(tInertiaA + tInertiaB, p.tangents[t]);
+				p.tangentMass[t] = tangentEffect > 0.0f ? 1.0f / tangentEffect : 0.0f;
+			}
+
+			// Separation speed to aim for: enough to bounce, or enough to push out the penetration, whichever's bigger.
+			Vector3 contactVelocity = (physB->GetLinearVelocity() + Vector3::Cross(physB->GetAngularVelocity(), p.relativeB))
+				- (physA->GetLinearVelocity() + Vector3::Cross(physA->GetAngularVelocity(), p.relativeA));
+			float approachSpeed = Vector3::Dot(contactVelocity, p.normal);
+
+			float bounce = approachSpeed < -restitutionThreshold ? -cRestitution * approachSpeed : 0.0f;
+			float push = (biasFactor / dt) * max(p.penetration - allowedPenetration, 0.0f);
+			p.targetVelocity = max(bounce, push);
+
+			// Warm start.
+			Vector3 impulse = p.normal * p.normalImpulse + p.tangents[0] * p.tangentImpulse[0] + p.tangents[1] * p.tangentImpulse[1];
+			physA->ApplyLinearImpulse(-impulse);
+			physB->ApplyLinearImpulse(impulse);
+			physA->ApplyAngularImpulse(Vector3::Cross(p.relativeA, -impulse));
+			physB->ApplyAngularImpulse(Vector3::Cross(p.relativeB, impulse));
+		}
+	}
+}
+
+// Sequential impulses: every contact is solved in turn, over and over, clamping the running total rather than each individual impulse.
+void PhysicsSystem::SolveContacts(float dt)
+{
+	PrepareContacts(dt);
+
+	for (int iteration = 0; iteration < solverIterations; ++iteration)
+	{
+		for (auto m = manifolds.begin(); m != manifolds.end(); ++m)
+		{
+			ContactManifold& manifold = m->second;
+			PhysicsObject* physA = manifold.GetObjectA()->GetPhysicsObject();
+			PhysicsObject* physB = manifold.GetObjectB()->GetPhysicsObject();
+
+			if (physA->GetInverseMass() + physB->GetInverseMass() == 0.0f)
+				continue;
+
+			for (int i = 0; i < manifold.GetNumPoints(); ++i)
+			{
+				ManifoldPoint& p = manifold.GetPoint(i);
+
+				// Friction first, limited by how hard the contact is currently pushing.
+				for (int t = 0; t < 2; ++t)
+				{
+					Vector3 contactVelocity = (physB->GetLinearVelocity() + Vector3::Cross(physB->GetAngularVelocity(), p.relativeB))
+						- (physA->GetLinearVelocity() + Vector3::Cross(physA->GetAngularVelocity(), p.relativeA));
+
+					float lambda = -Vector3::Dot(contactVelocity, p.tangents[t]) * p.tangentMass[t];
+					float maxFriction = contactFriction * p.normalImpulse;
+
+					float oldImpulse = p.tangentImpulse[t];
+					p.tangentImpulse[t] = Clamp(oldImpulse + lambda, -maxFriction, maxFriction);
+					lambda = p.tangentImpulse[t] - oldImpulse;
+
+					Vector3 impulse = p.tangents[t] * lambda;
+					physA->ApplyLinearImpulse(-impulse);
+					physB->ApplyLinearImpulse(impulse);
+					physA->ApplyAngularImpulse(Vector3::Cross(p.relativeA, -impulse));
+					physB->ApplyAngularImpulse(Vector3::Cross(p.relativeB, impulse));
+				}
+
+				Vector3 contactVelocity = (physB->GetLinearVelocity() + Vector3::Cross(physB->GetAngularVelocity(), p.relativeB))
+					- (physA->GetLinearVelocity() + Vector3::Cross(physA->GetAngularVelocity(), p.relativeA));
+
+				float lambda = (p.targetVelocity - Vector3::Dot(contactVelocity, p.normal)) * p.normalMass;
+
+				// Contacts can only ever push, so the total can't drop below zero- but a single iteration is allowed to pull some back.
+				float oldImpulse = p.normalImpulse;
+				p.normalImpulse = max(oldImpulse + lambda, 0.0f);
+				lambda = p.normalImpulse - oldImpulse;
+
+				Vector3 impulse = p.normal * lambda;
+				physA->ApplyLinearImpulse(-impulse);
+				physB->ApplyLinearImpulse(impulse);
+				physA->ApplyAngularImpulse(Vector3::Cross(p.relativeA, -impulse));
+				physB->ApplyAngularImpulse(Vector3::Cross(p.relativeB, impulse));
+			}
+		}
+	}
+}
+
+// Copy every awake, non-static body into the struct-of-arrays state so integration can run over flat arrays.
+void PhysicsSystem::GatherBodyState()
+{
 	std::vector<GameObject*>::const_iterator first;
 	std::vector<GameObject*>::const_iterator last;
 	gameWorld.GetObjectIterators(first, last);
 
+	bodyState.Clear();
 	for (auto i = first; i != last; ++i)
 	{
-		PhysicsObject* object = (*i)->GetPhysicsObject();
 		// Ignore the object if there's no physics object, or it's marked as sleeping or static.
-		if (object == nullptr || (*i)->IsSleeping() || (*i)->IsStatic())
-			continue; // No physics object for this game object
+		if ((*i)->GetPhysicsObject() == nullptr || (*i)->IsSleeping() || (*i)->IsStatic())
+			continue;
+		bodyState.objects.emplace_back(*i);
+	}
 
-		Vector3 posDiff = object->GetTransform()->GetLocalPosition() - object->GetTransform()->GetPreviousPosition();
-		float diff = posDiff.Length();
+	bodyState.Resize(bodyState.Size());
 
-		float inverseMass = object->GetInverseMass();
+	for (size_t i = 0; i < bodyState.Size(); ++i)
+	{
+		PhysicsObject* object = bodyState.objects[i]->GetPhysicsObject();
 
+		Vector3 position = bodyState.objects[i]->GetTransform().GetLocalPosition();
 		Vector3 linearVel = object->GetLinearVelocity();
+		Vector3 angVel = object->GetAngularVelocity();
 		Vector3 force = object->GetForce();
-		Vector3 accel = force * inverseMass;
+		Vector3 torque = object->GetTorque();
 
-		if (applyGravity && inverseMass > 0)
-			accel += gravity; // Don't move infinitely heavy things
+		bodyState.posX[i] = position.x; bodyState.posY[i] = position.y; bodyState.posZ[i] = position.z;
+		bodyState.linVelX[i] = linearVel.x; bodyState.linVelY[i] = linearVel.y; bodyState.linVelZ[i] = linearVel.z;
+		bodyState.angVelX[i] = angVel.x; bodyState.angVelY[i] = angVel.y; bodyState.angVelZ[i] = angVel.z;
+		bodyState.forceX[i] = force.x; bodyState.forceY[i] = force.y; bodyState.forceZ[i] = force.z;
+		bodyState.torqueX[i] = torque.x; bodyState.torqueY[i] = torque.y; bodyState.torqueZ[i] = torque.z;
+		bodyState.inverseMass[i] = object->GetInverseMass();
+
+		// The tensor is only rebuilt when a body's orientation actually changes (see IntegrateVelocity and RestoreSimulatedTransforms), not every frame.
+		Matrix3 inertia = object->GetInertiaTensor();
+		for (int m = 0; m < 9; ++m)
+			bodyState.invInertia[m][i] = inertia.array[m];
+	}
+}
 
-		linearVel += accel * dt; // integrate accel into a new velocity
+void PhysicsSystem::IntegrateAccel(float dt) {
+	GatherBodyState();
 
-		object->SetLinearVelocity(linearVel);
+	Vector3 appliedGravity = applyGravity ? gravity : Vector3(0, 0, 0);
 
-		// Angular motion stuff.
-		Vector3 torque = object->GetTorque();
-		Vector3 angVel = object->GetAngularVelocity();
+	float* linVelX = bodyState.linVelX.data(); float* linVelY = bodyState.linVelY.data(); float* linVelZ = bodyState.linVelZ.data();
+	float* angVelX = bodyState.angVelX.data(); float* angVelY = bodyState.angVelY.data(); float* angVelZ = bodyState.angVelZ.data();
+	const float* forceX = bodyState.forceX.data(); const float* forceY = bodyState.forceY.data(); const float* forceZ = bodyState.forceZ.data();
+	const float* torqueX = bodyState.torqueX.data(); const float* torqueY = bodyState.torqueY.data(); const float* torqueZ = bodyState.torqueZ.data();
+	const float* inverseMass = bodyState.inverseMass.data();
+	const float* m[9];
+	for (int k = 0; k < 9; ++k)
+		m[k] = bodyState.invInertia[k].data();
+
+	size_t count = bodyState.PaddedSize();
+
+#ifdef __AVX__
+	const __m256 dtV = _mm256_set1_ps(dt);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 gravX = _mm256_set1_ps(appliedGravity.x);
+	const __m256 gravY = _mm256_set1_ps(appliedGravity.y);
+	const __m256 gravZ = _mm256_set1_ps(appliedGravity.z);
 
-		// Update tensor vs orientation.
-		object->UpdateInertiaTensor();
+	for (size_t i = 0; i < count; i += RigidBodyState::LANE_WIDTH)
+	{
+		__m256 invMass = _mm256_loadu_ps(inverseMass + i);
+		// Don't move infinitely heavy things- gravity only applies to lanes with a non-zero inverse mass.
+		__m256 hasMass = _mm256_cmp_ps(invMass, zero, _CMP_GT_OQ);
+
+		__m256 accelX = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(forceX + i), invMass), _mm256_and_ps(hasMass, gravX));
+		__m256 accelY = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(forceY + i), invMass), _mm256_and_ps(hasMass, gravY));
+		__m256 accelZ = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(forceZ + i), invMass), _mm256_and_ps(hasMass, gravZ));
+
+		// Integrate accel into a new velocity.
+		_mm256_storeu_ps(linVelX + i, _mm256_add_ps(_mm256_loadu_ps(linVelX + i), _mm256_mul_ps(accelX, dtV)));
+		_mm256_storeu_ps(linVelY + i, _mm256_add_ps(_mm256_loadu_ps(linVelY + i), _mm256_mul_ps(accelY, dtV)));
+		_mm256_storeu_ps(linVelZ + i, _mm256_add_ps(_mm256_loadu_ps(linVelZ + i), _mm256_mul_ps(accelZ, dtV)));
+
+		// Angular acceleration is the inverse inertia tensor multiplied by the torque, same column major layout as Matrix3 * Vector3.
+		__m256 tX = _mm256_loadu_ps(torqueX + i);
+		__m256 tY = _mm256_loadu_ps(torqueY + i);
+		__m256 tZ = _mm256_loadu_ps(torqueZ + i);
+
+		__m256 angAccelX = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(m[0] + i), tX), _mm256_mul_ps(_mm256_loadu_ps(m[3] + i), tY)), _mm256_mul_ps(_mm256_loadu_ps(m[6] + i), tZ));
+		__m256 angAccelY = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(m[1] + i), tX), _mm256_mul_ps(_mm256_loadu_ps(m[4] + i), tY)), _mm256_mul_ps(_mm256_loadu_ps(m[7] + i), tZ));
+		__m256 angAccelZ = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(m[2] + i), tX), _mm256_mul_ps(_mm256_loadu_ps(m[5] + i), tY)), _mm256_mul_ps(_mm256_loadu_ps(m[8] + i), tZ));
+
+		_mm256_storeu_ps(angVelX + i, _mm256_add_ps(_mm256_loadu_ps(angVelX + i), _mm256_mul_ps(angAccelX, dtV)));
+		_mm256_storeu_ps(angVelY + i, _mm256_add_ps(_mm256_loadu_ps(angVelY + i), _mm256_mul_ps(angAccelY, dtV)));
+		_mm256_storeu_ps(angVelZ + i, _mm256_add_ps(_mm256_loadu_ps(angVelZ + i), _mm256_mul_ps(angAccelZ, dtV)));
+	}
+#else
+	// Scalar fallback for builds without AVX- same maths one lane at a time.
+	for (size_t i = 0; i < count; ++i)
+	{
+		float gravityScale = inverseMass[i] > 0 ? 1.0f : 0.0f;
 
-		Vector3 angAccel = object->GetInertiaTensor() * torque;
+		linVelX[i] += (forceX[i] * inverseMass[i] + appliedGravity.x * gravityScale) * dt;
+		linVelY[i] += (forceY[i] * inverseMass[i] + appliedGravity.y * gravityScale) * dt;
+		linVelZ[i] += (forceZ[i] * inverseMass[i] + appliedGravity.z * gravityScale) * dt;
 
-		// Integrate angular accel
-		angVel += angAccel * dt;
+		angVelX[i] += (m[0][i] * torqueX[i] + m[3][i] * torqueY[i] + m[6][i] * torqueZ[i]) * dt;
+		angVelY[i] += (m[1][i] * torqueX[i] + m[4][i] * torqueY[i] + m[7][i] * torqueZ[i]) * dt;
+		angVelZ[i] += (m[2][i] * torqueX[i] + m[5][i] * torqueY[i] + m[8][i] * torqueZ[i]) * dt;
+	}
+#endif
 
-		object->SetAngularVelocity(angVel);
+	// Collision resolution works on the physics objects directly, so they need the new velocities before the narrowphase.
+	for (size_t i = 0; i < bodyState.Size(); ++i)
+	{
+		PhysicsObject* object = bodyState.objects[i]->GetPhysicsObject();
+		object->SetLinearVelocity(Vector3(linVelX[i], linVelY[i], linVelZ[i]));
+		object->SetAngularVelocity(Vector3(angVelX[i], angVelY[i], angVelZ[i]));
 	}
 }
 
 void PhysicsSystem::IntegrateVelocity(float dt) {
-	std::vector<GameObject*>::const_iterator first;
-	std::vector<GameObject*>::const_iterator last;
-	gameWorld.GetObjectIterators(first, last);
-
-	float dampingFactor = 1.0f - 0.95f;
+	float dampingFactor = 1.0f - globalDamping;
 	float frameDamping = powf(dampingFactor, dt);
 
-	for (auto i = first; i != last; ++i)
+	// Collisions and constraints may have moved bodies or changed their velocities since IntegrateAccel, so refresh just those fields.
+	for (size_t i = 0; i < bodyState.Size(); ++i)
 	{
-		PhysicsObject* object = (*i)->GetPhysicsObject();
-		// Ignore the object if there's no physics object, or it's marked as sleeping or static.
-		if (object == nullptr || (*i)->IsSleeping() || (*i)->IsStatic())
-			continue;
+		GameObject* body = bodyState.objects[i];
+		Vector3 position = body->GetTransform().GetLocalPosition();
+		Vector3 linearVel = body->GetPhysicsObject()->GetLinearVelocity();
+		Vector3 angVel = body->GetPhysicsObject()->GetAngularVelocity();
+		body->SetPreviousPosition(position);
+
+		bodyState.posX[i] = position.x; bodyState.posY[i] = position.y; bodyState.posZ[i] = position.z;
+		bodyState.linVelX[i] = linearVel.x; bodyState.linVelY[i] = linearVel.y; bodyState.linVelZ[i] = linearVel.z;
+		bodyState.angVelX[i] = angVel.x; bodyState.angVelY[i] = angVel.y; bodyState.angVelZ[i] = angVel.z;
+	}
+
+	float* posX = bodyState.posX.data(); float* posY = bodyState.posY.data(); float* posZ = bodyState.posZ.data();
+	float* linVelX = bodyState.linVelX.data(); float* linVelY = bodyState.linVelY.data(); float* linVelZ = bodyState.linVelZ.data();
+	float* angVelX = bodyState.angVelX.data(); float* angVelY = bodyState.angVelY.data(); float* angVelZ = bodyState.angVelZ.data();
+	float* spinX = bodyState.spinX.data(); float* spinY = bodyState.spinY.data(); float* spinZ = bodyState.spinZ.data();
+	float* distanceMoved = bodyState.distanceMoved.data();
+
+	size_t count = bodyState.PaddedSize();
 
-		Transform& transform = (*i)->GetTransform();
+#ifdef __AVX__
+	const __m256 dtV = _mm256_set1_ps(dt);
+	const __m256 halfDtV = _mm256_set1_ps(dt * 0.5f);
+	const __m256 dampV = _mm256_set1_ps(frameDamping);
 
+	for (size_t i = 0; i < count; i += RigidBodyState::LANE_WIDTH)
+	{
 		// Position stuff
-		Vector3 position = transform.GetLocalPosition();
-		(*i)->SetPreviousPosition(position);
-		Vector3 linearVel = object->GetLinearVelocity();
-		position += linearVel * dt;
-		transform.SetLocalPosition(position);
-		transform.SetWorldPosition(position);
+		__m256 vX = _mm256_loadu_ps(linVelX + i);
+		__m256 vY = _mm256_loadu_ps(linVelY + i);
+		__m256 vZ = _mm256_loadu_ps(linVelZ + i);
+
+		__m256 stepX = _mm256_mul_ps(vX, dtV);
+		__m256 stepY = _mm256_mul_ps(vY, dtV);
+		__m256 stepZ = _mm256_mul_ps(vZ, dtV);
+
+		_mm256_storeu_ps(posX + i, _mm256_add_ps(_mm256_loadu_ps(posX + i), stepX));
+		_mm256_storeu_ps(posY + i, _mm256_add_ps(_mm256_loadu_ps(posY + i), stepY));
+		_mm256_storeu_ps(posZ + i, _mm256_add_ps(_mm256_loadu_ps(posZ + i), stepZ));
+
+		__m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(stepX, stepX), _mm256_mul_ps(stepY, stepY)), _mm256_mul_ps(stepZ, stepZ));
+		_mm256_storeu_ps(distanceMoved + i, _mm256_sqrt_ps(lengthSq));
+
+		// Orientation step uses the undamped angular velocity- 0.5 just due to how quaternions work!
+		__m256 wX = _mm256_loadu_ps(angVelX + i);
+		__m256 wY = _mm256_loadu_ps(angVelY + i);
+		__m256 wZ = _mm256_loadu_ps(angVelZ + i);
+
+		_mm256_storeu_ps(spinX + i, _mm256_mul_ps(wX, halfDtV));
+		_mm256_storeu_ps(spinY + i, _mm256_mul_ps(wY, halfDtV));
+		_mm256_storeu_ps(spinZ + i, _mm256_mul_ps(wZ, halfDtV));
+
+		// Linear and angular damping so nothing slides or spins forever.
+		_mm256_storeu_ps(linVelX + i, _mm256_mul_ps(vX, dampV));
+		_mm256_storeu_ps(linVelY + i, _mm256_mul_ps(vY, dampV));
+		_mm256_storeu_ps(linVelZ + i, _mm256_mul_ps(vZ, dampV));
+
+		_mm256_storeu_ps(angVelX + i, _mm256_mul_ps(wX, dampV));
+		_mm256_storeu_ps(angVelY + i, _mm256_mul_ps(wY, dampV));
+		_mm256_storeu_ps(angVelZ + i, _mm256_mul_ps(wZ, dampV));
+	}
+#else
+	for (size_t i = 0; i < count; ++i)
+	{
+		float stepX = linVelX[i] * dt;
+		float stepY = linVelY[i] * dt;
+		float stepZ = linVelZ[i] * dt;
+
+		posX[i] += stepX;
+		posY[i] += stepY;
+		posZ[i] += stepZ;
+		distanceMoved[i] = sqrtf(stepX * stepX + stepY * stepY + stepZ * stepZ);
+
+		spinX[i] = angVelX[i] * dt * 0.5f;
+		spinY[i] = angVelY[i] * dt * 0.5f;
+		spinZ[i] = angVelZ[i] * dt * 0.5f;
+
+		linVelX[i] *= frameDamping; linVelY[i] *= frameDamping; linVelZ[i] *= frameDamping;
+		angVelX[i] *= frameDamping; angVelY[i] *= frameDamping; angVelZ[i] *= frameDamping;
+	}
+#endif
+
+	// Write back- transforms and tensors are only touched for bodies that actually moved or turned.
+	for (size_t i = 0; i < bodyState.Size(); ++i)
+	{
+		GameObject* body = bodyState.objects[i];
+		PhysicsObject* object = body->GetPhysicsObject();
+		Transform& transform = body->GetTransform();
+
+		Vector3 position(posX[i], posY[i], posZ[i]);
+		Vector3 spin(spinX[i], spinY[i], spinZ[i]);
+		bool moved = distanceMoved[i] > 0.0f;
+		bool turned = spin.LengthSquared() > 0.0f;
+
+		if (moved)
+		{
+			transform.SetLocalPosition(position);
+			transform.SetWorldPosition(position);
+			object->SetLinearVelocity(Vector3(linVelX[i], linVelY[i], linVelZ[i]));
+		}
+
+		if (turned)
+		{
+			Quaternion orientation = transform.GetLocalOrientation();
+			orientation = orientation + (Quaternion(spin, 0.0f) * orientation);
+			orientation.Normalise();
+			transform.SetLocalOrientation(orientation);
+
+			object->SetAngularVelocity(Vector3(angVelX[i], angVelY[i], angVelZ[i]));
+			// Orientation changed so the world space tensor is out of date- the only place it needs rebuilding.
+			object->UpdateInertiaTensor();
+		}
 
 		// Determine over a number of updates whether this object has been static enough to sleep- prevents infinitely jiggling objects
-		float distanceMoved = (position - (*i)->GetPreviousPosition()).Length();
-		(*i)->amountMoved += distanceMoved;
-		(*i)->sleepPollCount += 1;
-		if ((*i)->sleepPollCount >= 60)
+		body->amountMoved += distanceMoved[i];
+		body->sleepPollCount += 1;
+		if (body->sleepPollCount >= 60)
 		{
-			float avgDistance = (*i)->amountMoved / 60;
+			float avgDistance = body->amountMoved / 60;
 			if (avgDistance < 0.01f)
 			{
-				(*i)->SetSleeping(true);
+				body->SetSleeping(true);
 			}
-			(*i)->amountMoved = 0;;
-			(*i)->sleepPollCount = 0;
+			body->amountMoved = 0;
+			body->sleepPollCount = 0;
 		}
-
-		// Linear damping
-		linearVel = linearVel * frameDamping; // slightly scale down the velocity based on the framerate
-		object->SetLinearVelocity(linearVel);
-
-		// Orientation stuff
-		Quaternion orientation = transform.GetLocalOrientation();
-		Vector3 angVel = object->GetAngularVelocity();
-
-		// Actual integration. 
-		// 0.5 just due to how quaternions work!
-		orientation = orientation + (Quaternion(angVel * dt * 0.5f, 0.0f) * orientation);
-		orientation.Normalise();
-
-		transform.SetLocalOrientation(orientation);
-
-		// Damp the angular velocity too so it doesn't just spin forever.
-		angVel = angVel * frameDamping;
-		object->SetAngularVelocity(angVel);
 	}
-
 }
@@ -1,72 +1,73 @@
 /* RECEIVER CONTENT */
-void ClientPacketReceiver::ReceivePacket(int type, GamePacket* payload, int source)
+
+// The coursework's own packets- fixed size, like nearly everything else.
+template <>
+struct NCL::CSC8503::PacketTraits<ClientPlayerInputPacket> : public FixedSizePacketTraits<ClientPlayerInputPacket, Client_Player_Input> {};
+template <>
+struct NCL::CSC8503::PacketTraits<NewPlayerPacket> : public FixedSizePacketTraits<NewPlayerPacket, Player_Connected> {};
+
+// What each end listens for. Adding a packet is just another line here and a handler for it.
+typedef PacketRegistry<ClientPacketReceiver> ClientPackets;
+typedef ClientPackets::Dispatcher<
+	ClientPackets::On<HighScoreUpdatePacket, &ClientPacketReceiver::ReceiveHighScores>,
+	ClientPackets::On<SnapshotPacket, &ClientPacketReceiver::ReceiveSnapshot>,
+	ClientPackets::On<PlayerAssignPacket, &ClientPacketReceiver::ReceivePlayerAssign>
+> ClientPacketDispatcher;
+
+typedef PacketRegistry<ServerPacketReceiver> ServerPackets;
+typedef ServerPackets::Dispatcher<
+	ServerPackets::On<HighScoreRequestPacket, &ServerPacketReceiver::ReceiveHighScoreRequest>,
+	ServerPackets::On<GooseInputPacket, &ServerPacketReceiver::ReceiveGooseInput>,
+	ServerPackets::On<ClientPlayerInputPacket, &ServerPacketReceiver::ReceivePickUp>,
+	ServerPackets::On<NewPlayerPacket, &ServerPacketReceiver::ReceiveNewPlayer>,
+	ServerPackets::On<SnapshotAckPacket, &ServerPacketReceiver::ReceiveSnapshotAck>
+> ServerPacketDispatcher;
+
+// Whatever's changed in the high score table since the version we asked with.
+void ClientPacketReceiver::ReceiveHighScores(const HighScoreUpdatePacket& packet, int source)
+{
+	game->ClientReadHighScores(packet);
+}
+
+// The server's world snapshot- everything it runs, plus the timer and held item.
+void ClientPacketReceiver::ReceiveSnapshot(const SnapshotPacket& packet, int source)
+{
+	game->ClientReadSnapshot(packet);
+}
+
+// Which goose is ours to play.
+void ClientPacketReceiver::ReceivePlayerAssign(const PlayerAssignPacket& packet, int source)
 {
-	if (type == String_Message)
-	{
-		// This will be high score data!
-		StringPacket* realPacket = (StringPacket*)payload;
-		string msg = realPacket->GetStringFromData();
-		game->FillHighScores(msg);
-	}
-	else if (type == Position_Message)
-	{
-		PositionPacket* realPacket = (PositionPacket*)payload;
-		Vector3 pos = realPacket->force;
+	game->ClientAssignGoose(packet.gooseIndex);
+}
 
-		// Client worlds update their park keeper with the position sent by the server.
-		game->MoveKeeperForClients(pos);
-	}
-	else if (type == Held_Item_Update)
-	{
-		HeldItemUpdatePacket* realPacket = (HeldItemUpdatePacket*)payload;
-		int itemId = realPacket->itemId;
+// Client has requested the high score table
+void ServerPacketReceiver::ReceiveHighScoreRequest(const HighScoreRequestPacket& packet, int source)
+{
+	game->SendHighScoreTable(source, packet.knownTable, packet.knownVersion);
+}
 
-		if (itemId > -1)
-		{
-			// There was a successful item event, so grab that particular item and give it to the goose.
-			game->ClientPickUpItem(itemId);
-		}
-	}
-	else if (type == Int_Message)
-	{
-		// This will be timer data!
-		IntPacket* realPacket = (IntPacket*)payload;
-		int timeValue = realPacket->i;
+// Update the goose to match what the client is doing. The number goes back in the snapshots so the client can check its prediction.
+void ServerPacketReceiver::ReceiveGooseInput(const GooseInputPacket& packet, int source)
+{
+	game->SetGooseInputForServer(source, packet);
+}
 
-		game->ClientSetTimer(timeValue);
-	}
+// Client player has tried to pick up an item.
+void ServerPacketReceiver::ReceivePickUp(const ClientPlayerInputPacket& packet, int source)
+{
+	game->ServerPickUpItem(source);
 }
 
-void ServerPacketReceiver::ReceivePacket(int type, GamePacket* payload, int source)
+// Start the timer now that a player has joined so the timer and game length will be in sync.
+void ServerPacketReceiver::ReceiveNewPlayer(const NewPlayerPacket& packet, int source)
 {
-	if (type == String_Message)
-	{
-		StringPacket* realPacket = (StringPacket*)payload;
-		string msg = realPacket->GetStringFromData();
+	game->StartTimer();
+	game->ServerAddClient(source);
+}
 
-	}
-	else if (type == Request)
-	{
-		// Client has requested the high score table
-		game->SendHighScoreTable();
-	}
-	else if (type == Position_Message)
-	{
-		// Update the goose to match what the client is doing.
-		PositionPacket* realPacket = (PositionPacket*)payload;
-		Vector3 force = realPacket->force;
-		float yTorque = realPacket->yTorque;
-		float direction = realPacket->direction;
-		game->MoveGooseForServer(force, yTorque, direction);
-	}
-	else if (type == Client_Player_Input)
-	{
-		// Client player has tried to pick up an item.
-		game->ServerPickUpItem();
-	}
-	else if (type == Player_Connected)
-	{
-		// Start the timer now that a player has joined so the timer and game length will be in sync.
-		game->StartTimer();
-	}
+// Client has got a snapshot, so later ones can be sent as deltas against it.
+void ServerPacketReceiver::ReceiveSnapshotAck(const SnapshotAckPacket& packet, int source)
+{
+	game->ServerAcknowledgeSnapshot(source, packet.sequence);
 }
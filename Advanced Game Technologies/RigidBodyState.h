@@ -0,0 +1,99 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A struct-of-arrays copy of the awake, non-static bodies in the physics system.
+Integration runs over these flat arrays rather than chasing pointers through every GameObject.
+Also holds the poses used to blend rendering between fixed physics steps.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include <vector>
+#include "../../Common/Vector3.h"
+#include "../../Common/Quaternion.h"
+
+using namespace NCL::Maths;
+
+namespace NCL {
+	namespace CSC8503 {
+		class GameObject;
+
+		struct RigidBodyState
+		{
+			// Integration is done 8 bodies at a time, so every array is padded up to a multiple of this.
+			static const size_t LANE_WIDTH = 8;
+
+			std::vector<GameObject*> objects;
+
+			std::vector<float> posX, posY, posZ;
+			std::vector<float> linVelX, linVelY, linVelZ;
+			std::vector<float> angVelX, angVelY, angVelZ;
+			std::vector<float> forceX, forceY, forceZ;
+			std::vector<float> torqueX, torqueY, torqueZ;
+			std::vector<float> inverseMass;
+
+			// World space inverse inertia tensor, stored in the same column major order as Matrix3.
+			std::vector<float> invInertia[9];
+
+			// How far each body moved in the last velocity integration, used for sleeping and transform write back.
+			std::vector<float> distanceMoved;
+
+			// Half angle orientation step from the last velocity integration, taken before the angular velocity is damped.
+			std::vector<float> spinX, spinY, spinZ;
+
+			size_t Size() const { return objects.size(); }
+			size_t PaddedSize() const { return posX.size(); }
+
+			void Clear() { objects.clear(); }
+
+			// Zero every array out to the padded size so the unused lanes at the end can't hold stale bodies.
+			void Resize(size_t count)
+			{
+				size_t padded = (count + LANE_WIDTH - 1) & ~(LANE_WIDTH - 1);
+
+				std::vector<float>* arrays[] = {
+					&posX, &posY, &posZ,
+					&linVelX, &linVelY, &linVelZ,
+					&angVelX, &angVelY, &angVelZ,
+					&forceX, &forceY, &forceZ,
+					&torqueX, &torqueY, &torqueZ,
+					&inverseMass, &distanceMoved,
+					&spinX, &spinY, &spinZ
+				};
+
+				for (std::vector<float>* a : arrays)
+					a->assign(padded, 0.0f);
+
+				for (int i = 0; i < 9; ++i)
+					invInertia[i].assign(padded, 0.0f);
+			}
+		};
+
+		// Poses either side of the last fixed physics step, so rendering can be blended between them.
+		struct InterpolatedPose
+		{
+			GameObject* object;
+
+			Vector3 previousPosition;
+			Quaternion previousOrientation;
+
+			// What the simulation actually has, restored before the next step runs.
+			Vector3 simulatedPosition;
+			Quaternion simulatedOrientation;
+
+			// What was handed to the renderer, so anything gameplay moved or turned in between isn't stomped on.
+			Vector3 renderedPosition;
+			Quaternion renderedOrientation;
+		};
+
+		// Forces gameplay's added over frames that haven't run a step yet, kept as the impulse they'd have given.
+		struct AccumulatedImpulse
+		{
+			Vector3 linear;
+			Vector3 angular;
+		};
+	}
+}
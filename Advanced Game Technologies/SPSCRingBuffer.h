@@ -0,0 +1,78 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A fixed size ring buffer for handing things from exactly one thread to exactly one other without any locks.
+The producer only ever writes the tail and the consumer only ever writes the head, each on a cache line of its own so the two
+threads aren't fighting over one, and each side keeps its own copy of the other's index so it only has to read the shared one
+when it looks full (or empty).
+Items are written and read in place- Claim a slot, fill it, Publish it; Front to look at the oldest, Pop when done with it.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include <atomic>
+
+namespace NCL {
+	namespace CSC8503 {
+		template <typename T, int Capacity>
+		class SPSCRingBuffer
+		{
+			static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity has to be a power of two");
+
+		public:
+			SPSCRingBuffer() : head(0), tail(0), cachedHead(0), cachedTail(0) {}
+			~SPSCRingBuffer() {}
+
+			// Producer- somewhere to write the next item, or nullptr if it's full.
+			T* Claim()
+			{
+				unsigned int position = tail.load(std::memory_order_relaxed);
+				if (position - cachedHead == Capacity)
+				{
+					cachedHead = head.load(std::memory_order_acquire);
+					if (position - cachedHead == Capacity)
+						return nullptr;
+				}
+				return &slots[position & (Capacity - 1)];
+			}
+
+			// Producer- the claimed slot's ready to be read.
+			void Publish()
+			{
+				tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+			}
+
+			// Consumer- the oldest item, or nullptr if there's nothing there.
+			T* Front()
+			{
+				unsigned int position = head.load(std::memory_order_relaxed);
+				if (position == cachedTail)
+				{
+					cachedTail = tail.load(std::memory_order_acquire);
+					if (position == cachedTail)
+						return nullptr;
+				}
+				return &slots[position & (Capacity - 1)];
+			}
+
+			// Consumer- finished with the oldest, so the producer can have its slot back.
+			void Pop()
+			{
+				head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+			}
+
+		protected:
+			T slots[Capacity];
+
+			// Indices only ever count up- wrapping round the unsigned int is fine as long as Capacity divides into it.
+			alignas(64) std::atomic<unsigned int> head;
+			alignas(64) std::atomic<unsigned int> tail;
+			// Each side's last look at the other's index. cachedHead is the producer's, cachedTail the consumer's.
+			alignas(64) unsigned int cachedHead;
+			alignas(64) unsigned int cachedTail;
+		};
+	}
+}
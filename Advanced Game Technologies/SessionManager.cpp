@@ -0,0 +1,85 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+The server's per-client sessions, each with a scheduler of its own.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "SessionManager.h"
+using namespace NCL;
+using namespace CSC8503;
+
+SessionManager::SessionManager(float tickRate, float timeout, std::function<void(int, GamePacket&)> sendToPeer, PacketReceiver* receiver,
+	std::function<void(ClientSession&)> onRemove)
+{
+	this->tickRate = tickRate;
+	this->timeout = timeout;
+	this->sendToPeer = sendToPeer;
+	this->receiver = receiver;
+	this->onRemove = onRemove;
+}
+
+SessionManager::~SessionManager()
+{
+	for (auto& session : sessions)
+		delete session.second.scheduler;
+}
+
+ClientSession& SessionManager::Open(int peer)
+{
+	ClientSession& session = sessions[peer];
+	session.peer = peer;
+	session.idleTime = 0.0f;
+	session.gooseIndex = -1;
+	session.heldItemID = -1;
+	session.inputs.Clear();
+
+	std::function<void(int, GamePacket&)> send = sendToPeer;
+	session.scheduler = new NetworkScheduler(tickRate, [send, peer](GamePacket& batch) { send(peer, batch); }, receiver);
+	return session;
+}
+
+void SessionManager::Remove(std::map<int, ClientSession>::iterator it)
+{
+	onRemove(it->second);
+	delete it->second.scheduler;
+	sessions.erase(it);
+}
+
+void SessionManager::ReceivePacket(int type, GamePacket* payload, int source)
+{
+	if (type != Message_Batch)
+		return;
+
+	auto it = sessions.find(source);
+	ClientSession& session = (it != sessions.end()) ? it->second : Open(source);
+	session.idleTime = 0.0f;
+	session.scheduler->ReceivePacket(type, payload, source);
+}
+
+ClientSession* SessionManager::Find(int peer)
+{
+	auto it = sessions.find(peer);
+	return it != sessions.end() ? &it->second : nullptr;
+}
+
+void SessionManager::Update(float dt)
+{
+	for (auto it = sessions.begin(); it != sessions.end();)
+	{
+		ClientSession& session = it->second;
+		session.idleTime += dt;
+		// Peer numbers get reused, so a new client in the same slot mustn't pick up where the old one left off.
+		if (session.idleTime > timeout)
+		{
+			Remove(it++);
+			continue;
+		}
+
+		session.scheduler->Update(dt);
+		++it;
+	}
+}
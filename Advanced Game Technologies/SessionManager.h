@@ -0,0 +1,91 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Everything the server keeps per connected client. Each client gets a session the first time anything arrives from it, with its own
+network scheduler (so reliable messages are sequenced and acknowledged per client, and anything sent to it goes to it alone),
+the goose it's playing, its queued inputs and which objects it's currently interested in.
+Clients always send something every network tick, so one that's gone quiet for long enough has gone and its session is dropped.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "../CSC8503Common/NetworkBase.h"
+#include "NetworkScheduler.h"
+#include "GoosePrediction.h"
+#include "../../Common/Vector3.h"
+#include <functional>
+#include <map>
+#include <vector>
+
+using namespace NCL::Maths;
+
+namespace NCL {
+	namespace CSC8503 {
+		// Tells a client which of the level's geese is theirs, by its order in the level file. -1 for none free- they can watch.
+		struct PlayerAssignPacket : public GamePacket
+		{
+			int gooseIndex;
+
+			PlayerAssignPacket(int gooseIndex)
+			{
+				type = Player_Assign;
+				size = sizeof(int);
+				this->gooseIndex = gooseIndex;
+			}
+		};
+
+		template <>
+		struct PacketTraits<PlayerAssignPacket> : public FixedSizePacketTraits<PlayerAssignPacket, Player_Assign> {};
+
+		struct ClientSession
+		{
+			int peer;
+			NetworkScheduler* scheduler;
+			// Since anything last arrived from it.
+			float idleTime;
+
+			// Which of the level's geese it's playing, -1 for none.
+			int gooseIndex;
+			int heldItemID;
+
+			// Its goose inputs, played out over the server's frames for as long as each lasted on the client.
+			GooseInputQueue inputs;
+
+			// Indexed like the snapshot's objects.
+			std::vector<bool> relevant;
+		};
+
+		class SessionManager : public PacketReceiver
+		{
+		public:
+			// sendToPeer sends one client's batches to it alone, receiver gets everything unpacked from them. onRemove is told before a session goes.
+			SessionManager(float tickRate, float timeout, std::function<void(int, GamePacket&)> sendToPeer, PacketReceiver* receiver,
+				std::function<void(ClientSession&)> onRemove);
+			~SessionManager();
+
+			void ReceivePacket(int type, GamePacket* payload, int source = -1) override;
+
+			// Sends every session's batch on the network tick, and drops any that have gone quiet.
+			void Update(float dt);
+
+			ClientSession* Find(int peer);
+			std::map<int, ClientSession>& GetSessions() { return sessions; }
+			int GetCount() const { return (int)sessions.size(); }
+
+		protected:
+			ClientSession& Open(int peer);
+			void Remove(std::map<int, ClientSession>::iterator it);
+
+			std::map<int, ClientSession> sessions;
+
+			float tickRate;
+			float timeout;
+			std::function<void(int, GamePacket&)> sendToPeer;
+			std::function<void(ClientSession&)> onRemove;
+			PacketReceiver* receiver;
+		};
+	}
+}
@@ -0,0 +1,137 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A uniform grid of buckets over the ground plane, for radius queries.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "SpatialHash.h"
+#include <cmath>
+using namespace NCL;
+using namespace CSC8503;
+
+SpatialHash::SpatialHash(float cellSize, int bucketCount)
+{
+	this->cellSize = cellSize;
+	buckets.resize(bucketCount);
+}
+
+int SpatialHash::CellCoord(float value) const
+{
+	return (int)floorf(value / cellSize);
+}
+
+int SpatialHash::BucketFor(int cellX, int cellZ) const
+{
+	// Two large primes to scatter neighbouring cells across the table.
+	unsigned int hash = ((unsigned int)cellX * 73856093u) ^ ((unsigned int)cellZ * 19349663u);
+	return (int)(hash % buckets.size());
+}
+
+int SpatialHash::Add(const Vector3& position)
+{
+	int handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else
+	{
+		handle = (int)entries.size();
+		entries.emplace_back();
+	}
+
+	Entry& entry = entries[handle];
+	entry.x = position.x;
+	entry.z = position.z;
+	entry.cellX = CellCoord(position.x);
+	entry.cellZ = CellCoord(position.z);
+	Insert(handle);
+	return handle;
+}
+
+void SpatialHash::Move(int handle, const Vector3& position)
+{
+	Entry& entry = entries[handle];
+	entry.x = position.x;
+	entry.z = position.z;
+
+	int cellX = CellCoord(position.x);
+	int cellZ = CellCoord(position.z);
+
+	// Most things don't leave their cell in a frame, so most moves stop here.
+	if (cellX == entry.cellX && cellZ == entry.cellZ)
+		return;
+
+	Unlink(handle);
+	entry.cellX = cellX;
+	entry.cellZ = cellZ;
+	Insert(handle);
+}
+
+void SpatialHash::Remove(int handle)
+{
+	Unlink(handle);
+	freeHandles.emplace_back(handle);
+}
+
+void SpatialHash::Clear()
+{
+	for (std::vector<int>& bucket : buckets)
+		bucket.clear();
+	entries.clear();
+	freeHandles.clear();
+}
+
+void SpatialHash::Insert(int handle)
+{
+	Entry& entry = entries[handle];
+	entry.bucket = BucketFor(entry.cellX, entry.cellZ);
+	entry.slot = (int)buckets[entry.bucket].size();
+	buckets[entry.bucket].emplace_back(handle);
+}
+
+void SpatialHash::Unlink(int handle)
+{
+	Entry& entry = entries[handle];
+	std::vector<int>& bucket = buckets[entry.bucket];
+
+	int last = bucket.back();
+	bucket[entry.slot] = last;
+	entries[last].slot = entry.slot;
+	bucket.pop_back();
+}
+
+void SpatialHash::QueryRadius(const Vector3& position, float radius, std::vector<int>& outHandles) const
+{
+	outHandles.clear();
+
+	int minX = CellCoord(position.x - radius);
+	int maxX = CellCoord(position.x + radius);
+	int minZ = CellCoord(position.z - radius);
+	int maxZ = CellCoord(position.z + radius);
+	float radiusSq = radius * radius;
+
+	for (int cellZ = minZ; cellZ <= maxZ; ++cellZ)
+	{
+		for (int cellX = minX; cellX <= maxX; ++cellX)
+		{
+			for (int handle : buckets[BucketFor(cellX, cellZ)])
+			{
+				const Entry& entry = entries[handle];
+				// Other cells can share the bucket, so skip anything not actually in this one.
+				if (entry.cellX != cellX || entry.cellZ != cellZ)
+					continue;
+
+				float dx = entry.x - position.x;
+				float dz = entry.z - position.z;
+				if (dx * dx + dz * dz < radiusSq)
+					outHandles.emplace_back(handle);
+			}
+		}
+	}
+}
@@ -0,0 +1,62 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+A uniform grid of buckets over the ground plane, for finding everything within some radius of a point without checking everything.
+Entries are moved rather than rebuilt each frame, and only actually change bucket when they cross into a different cell.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "../../Common/Vector3.h"
+#include <vector>
+
+using namespace NCL::Maths;
+
+namespace NCL {
+	namespace CSC8503 {
+		class SpatialHash
+		{
+		public:
+			// Cells about the size of the usual query radius keep each query down to a handful of cells.
+			SpatialHash(float cellSize = 20.0f, int bucketCount = 1024);
+			~SpatialHash() {}
+
+			// Returns a handle to move or remove the entry by later. Handles of removed entries get reused.
+			int Add(const Vector3& position);
+			void Move(int handle, const Vector3& position);
+			void Remove(int handle);
+			void Clear();
+
+			// Every entry within radius of position, ignoring height.
+			void QueryRadius(const Vector3& position, float radius, std::vector<int>& outHandles) const;
+
+			int GetCount() const { return (int)entries.size() - (int)freeHandles.size(); }
+
+		protected:
+			struct Entry
+			{
+				float x;
+				float z;
+				int cellX;
+				int cellZ;
+				int bucket;
+				// Where it sits in its bucket, so it can be swapped out without searching.
+				int slot;
+			};
+
+			int CellCoord(float value) const;
+			int BucketFor(int cellX, int cellZ) const;
+			void Insert(int handle);
+			void Unlink(int handle);
+
+			float cellSize;
+			std::vector<Entry> entries;
+			std::vector<int> freeHandles;
+			// More than one cell can land in the same bucket- queries check the actual distance anyway.
+			std::vector<std::vector<int>> buckets;
+		};
+	}
+}
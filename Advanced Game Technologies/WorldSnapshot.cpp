@@ -0,0 +1,563 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Replicating the state of the whole world from the server to its clients in one packet per network tick.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#include "WorldSnapshot.h"
+#include "BitStream.h"
+#include "../CSC8503Common/GameObject.h"
+#include <cmath>
+#include <iostream>
+using namespace NCL;
+using namespace CSC8503;
+
+// Positions are stored as 16 bit fixed point from here, which covers 1024 units either way- a good margin past the edges of any level.
+const float POSITION_MIN = -512.0f;
+const float POSITION_STEPS_PER_UNIT = 64.0f;
+const int POSITION_BITS = 16;
+const int POSITION_MAX_STEP = (1 << POSITION_BITS) - 1;
+
+// A move this many steps or fewer along every axis gets sent as a delta rather than the whole position.
+const int SMALL_DELTA_MIN = -32;
+const int SMALL_DELTA_MAX = 31;
+
+// None of the three smallest components of a unit quaternion can be bigger than 1/sqrt(2).
+const float ORIENTATION_RANGE = 0.70710678f;
+const int ORIENTATION_BITS = 10;
+const int ORIENTATION_MAX_STEP = (1 << ORIENTATION_BITS) - 1;
+
+// How the client's interpolation clock follows the snapshots coming in: never more than 25% faster or slower than real time, reset past half a second out.
+const float MAX_CLOCK_DRIFT = 0.5f;
+const float CLOCK_CORRECTION_RATE = 4.0f;
+const float MAX_CLOCK_SKEW = 0.25f;
+
+const int MAX_TIME = 4095;
+const int MAX_ITEM_ID = 1022;
+const int MAX_OBJECTS = 1023;
+
+// What an object a client hasn't been sent yet decodes to. A full snapshot is just a delta against a world of these, so objects can be left
+// out of it when it won't all fit in one packet. It's a corner well past the edge of any level, so nothing real ever sits on it.
+const QuantisedTransform UNSENT = { 0, 0, 0, 0 };
+
+/* QUANTISATION */
+
+int QuantiseAxis(float value)
+{
+	int step = (int)floorf((value - POSITION_MIN) * POSITION_STEPS_PER_UNIT + 0.5f);
+	return step < 0 ? 0 : (step > POSITION_MAX_STEP ? POSITION_MAX_STEP : step);
+}
+
+float DequantiseAxis(int step)
+{
+	return POSITION_MIN + step / POSITION_STEPS_PER_UNIT;
+}
+
+QuantisedTransform NCL::CSC8503::QuantiseTransform(const Vector3& position, const Quaternion& orientation)
+{
+	QuantisedTransform transform;
+	transform.x = QuantiseAxis(position.x);
+	transform.y = QuantiseAxis(position.y);
+	transform.z = QuantiseAxis(position.z);
+
+	// Smallest three: drop the biggest component and rebuild it from the others, since they all have to add up to one.
+	float components[4] = { orientation.x, orientation.y, orientation.z, orientation.w };
+	int largest = 0;
+	for (int i = 1; i < 4; ++i)
+	{
+		if (fabsf(components[i]) > fabsf(components[largest]))
+			largest = i;
+	}
+	// q and -q are the same rotation, so flip it to keep the dropped one positive.
+	float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+	unsigned int packed = (unsigned int)largest;
+	for (int i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			continue;
+		float normalised = (components[i] * sign + ORIENTATION_RANGE) / (2.0f * ORIENTATION_RANGE);
+		int step = (int)floorf(normalised * ORIENTATION_MAX_STEP + 0.5f);
+		step = step < 0 ? 0 : (step > ORIENTATION_MAX_STEP ? ORIENTATION_MAX_STEP : step);
+		packed = (packed << ORIENTATION_BITS) | (unsigned int)step;
+	}
+	transform.orientation = packed;
+	return transform;
+}
+
+Vector3 NCL::CSC8503::DequantisePosition(const QuantisedTransform& transform)
+{
+	return Vector3(DequantiseAxis(transform.x), DequantiseAxis(transform.y), DequantiseAxis(transform.z));
+}
+
+Quaternion NCL::CSC8503::DequantiseOrientation(const QuantisedTransform& transform)
+{
+	int largest = (int)(transform.orientation >> (ORIENTATION_BITS * 3));
+	float components[4];
+	float sumSquares = 0.0f;
+	int shift = ORIENTATION_BITS * 2;
+
+	for (int i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			continue;
+		int step = (int)((transform.orientation >> shift) & ORIENTATION_MAX_STEP);
+		components[i] = (step / (float)ORIENTATION_MAX_STEP) * 2.0f * ORIENTATION_RANGE - ORIENTATION_RANGE;
+		sumSquares += components[i] * components[i];
+		shift -= ORIENTATION_BITS;
+	}
+	components[largest] = sqrtf(sumSquares < 1.0f ? 1.0f - sumSquares : 0.0f);
+
+	Quaternion orientation(components[0], components[1], components[2], components[3]);
+	orientation.Normalise();
+	return orientation;
+}
+
+/* ENCODING */
+
+void WriteObject(BitWriter& writer, const QuantisedTransform& current, const QuantisedTransform& previous)
+{
+	// Most of the world is sat still at any one time, so this is all most objects ever cost.
+	bool changed = current != previous;
+	writer.WriteBool(changed);
+	if (!changed)
+		return;
+
+	bool moved = current.x != previous.x || current.y != previous.y || current.z != previous.z;
+	writer.WriteBool(moved);
+	if (moved)
+	{
+		int dx = current.x - previous.x;
+		int dy = current.y - previous.y;
+		int dz = current.z - previous.z;
+		bool small =
+			dx >= SMALL_DELTA_MIN && dx <= SMALL_DELTA_MAX &&
+			dy >= SMALL_DELTA_MIN && dy <= SMALL_DELTA_MAX &&
+			dz >= SMALL_DELTA_MIN && dz <= SMALL_DELTA_MAX;
+
+		writer.WriteBool(small);
+		if (small)
+		{
+			writer.WriteInt(dx, SMALL_DELTA_MIN, SMALL_DELTA_MAX);
+			writer.WriteInt(dy, SMALL_DELTA_MIN, SMALL_DELTA_MAX);
+			writer.WriteInt(dz, SMALL_DELTA_MIN, SMALL_DELTA_MAX);
+		}
+		else
+		{
+			writer.WriteBits(current.x, POSITION_BITS);
+			writer.WriteBits(current.y, POSITION_BITS);
+			writer.WriteBits(current.z, POSITION_BITS);
+		}
+	}
+
+	bool rotated = current.orientation != previous.orientation;
+	writer.WriteBool(rotated);
+	if (rotated)
+		writer.WriteBits(current.orientation, 2 + ORIENTATION_BITS * 3);
+}
+
+// Exactly what WriteObject would spend on it, by writing it somewhere that's thrown away.
+int ObjectBits(const QuantisedTransform& current, const QuantisedTransform& previous)
+{
+	char scratch[16];
+	BitWriter writer(scratch, sizeof(scratch));
+	WriteObject(writer, current, previous);
+	return writer.GetBitsWritten();
+}
+
+// Returns the number of bits written, or -1 if it didn't fit.
+int NCL::CSC8503::WriteSnapshot(const WorldSnapshot& snapshot, const WorldSnapshot* baseline, char* buffer, int capacityBytes)
+{
+	BitWriter writer(buffer, capacityBytes);
+	bool full = baseline == nullptr;
+
+	bool timeChanged = full || snapshot.timeRemaining != baseline->timeRemaining;
+	writer.WriteBool(timeChanged);
+	if (timeChanged)
+		writer.WriteInt(snapshot.timeRemaining, 0, MAX_TIME);
+
+	bool itemChanged = full || snapshot.heldItem != baseline->heldItem;
+	writer.WriteBool(itemChanged);
+	if (itemChanged)
+		writer.WriteInt(snapshot.heldItem, -1, MAX_ITEM_ID);
+
+	// Moves on every snapshot while someone's playing, but there's no telling how far, so the whole thing.
+	bool inputChanged = full || snapshot.lastInput != baseline->lastInput;
+	writer.WriteBool(inputChanged);
+	if (inputChanged)
+		writer.WriteBits((unsigned int)(snapshot.lastInput + 1), 32);
+
+	// Both ends should already agree on this, but it's cheap to make sure.
+	int count = (int)snapshot.objects.size();
+	writer.WriteInt(count, 0, MAX_OBJECTS);
+
+	for (int i = 0; i < count; ++i)
+		WriteObject(writer, snapshot.objects[i], full ? UNSENT : baseline->objects[i]);
+
+	return writer.HasOverflowed() ? -1 : writer.GetBitsWritten();
+}
+
+bool NCL::CSC8503::ReadSnapshot(const char* buffer, int sizeBytes, const WorldSnapshot* baseline, int objectCount, WorldSnapshot& outSnapshot)
+{
+	BitReader reader(buffer, sizeBytes);
+	bool full = baseline == nullptr;
+
+	if (!full && (int)baseline->objects.size() != objectCount)
+		return false;
+
+	outSnapshot.timeRemaining = reader.ReadBool() ? reader.ReadInt(0, MAX_TIME) : (full ? 0 : baseline->timeRemaining);
+	outSnapshot.heldItem = reader.ReadBool() ? reader.ReadInt(-1, MAX_ITEM_ID) : (full ? -1 : baseline->heldItem);
+	outSnapshot.lastInput = reader.ReadBool() ? (int)reader.ReadBits(32) - 1 : (full ? -1 : baseline->lastInput);
+
+	if (reader.ReadInt(0, MAX_OBJECTS) != objectCount)
+		return false;
+
+	outSnapshot.objects.resize(objectCount);
+	for (int i = 0; i < objectCount; ++i)
+	{
+		QuantisedTransform& current = outSnapshot.objects[i];
+		current = full ? UNSENT : baseline->objects[i];
+
+		if (!reader.ReadBool())
+			continue;
+
+		if (reader.ReadBool())
+		{
+			if (reader.ReadBool())
+			{
+				current.x += reader.ReadInt(SMALL_DELTA_MIN, SMALL_DELTA_MAX);
+				current.y += reader.ReadInt(SMALL_DELTA_MIN, SMALL_DELTA_MAX);
+				current.z += reader.ReadInt(SMALL_DELTA_MIN, SMALL_DELTA_MAX);
+			}
+			else
+			{
+				current.x = (int)reader.ReadBits(POSITION_BITS);
+				current.y = (int)reader.ReadBits(POSITION_BITS);
+				current.z = (int)reader.ReadBits(POSITION_BITS);
+			}
+		}
+
+		if (reader.ReadBool())
+			current.orientation = reader.ReadBits(2 + ORIENTATION_BITS * 3);
+	}
+
+	return !reader.HasOverflowed();
+}
+
+/* SENDER */
+
+SnapshotSender::SnapshotSender(float sendRate)
+{
+	SetSendRate(sendRate);
+	sendTimer = 0.0f;
+	nextSequence = 0;
+	timeRemaining = 0;
+	lastPacketBits = 0;
+	truncatedSnapshots = 0;
+}
+
+void SnapshotSender::Clear()
+{
+	objects.clear();
+	current.sequence = -1;
+	// Nothing anyone's acknowledged so far will match the new level.
+	for (auto& client : clients)
+	{
+		client.second.acknowledged = -1;
+		client.second.truncating = false;
+		for (WorldSnapshot& snapshot : client.second.history)
+			snapshot.sequence = -1;
+	}
+}
+
+void SnapshotSender::AddClient(int client)
+{
+	// Doesn't reset anything for a client that's already here.
+	clients[client];
+}
+
+void SnapshotSender::Acknowledge(int client, int sequence)
+{
+	auto it = clients.find(client);
+	// Acks can arrive out of order- only ever move forwards.
+	if (it != clients.end() && sequence > it->second.acknowledged)
+		it->second.acknowledged = sequence;
+}
+
+int SnapshotSender::ChooseBaseline(const ClientStream& stream) const
+{
+	int acknowledged = stream.acknowledged;
+
+	// Too old to still be in the history (or nothing acknowledged yet), so start again from a full snapshot.
+	if (acknowledged < 0 || acknowledged <= current.sequence - SNAPSHOT_HISTORY || stream.history[acknowledged % SNAPSHOT_HISTORY].sequence != acknowledged)
+		return -1;
+	return acknowledged;
+}
+
+void SnapshotSender::Capture(WorldSnapshot& snapshot) const
+{
+	snapshot.timeRemaining = timeRemaining;
+	snapshot.objects.resize(objects.size());
+	for (size_t i = 0; i < objects.size(); ++i)
+	{
+		const Transform& transform = objects[i]->GetConstTransform();
+		snapshot.objects[i] = QuantiseTransform(transform.GetWorldPosition(), transform.GetLocalOrientation());
+	}
+}
+
+bool SnapshotSender::Update(float dt)
+{
+	sendTimer += dt;
+	if (sendTimer < sendInterval)
+		return false;
+	// Don't try and catch up with a burst of snapshots after a long frame.
+	sendTimer = fmodf(sendTimer, sendInterval);
+
+	// Every client's snapshot this tick shares the one number, so the clients' clocks all run off the same server time.
+	current.sequence = nextSequence++;
+	Capture(current);
+	return true;
+}
+
+bool SnapshotSender::Write(int client, int heldItem, int lastInput, const std::vector<bool>* relevant, SnapshotPacket& packet)
+{
+	auto it = clients.find(client);
+	if (it == clients.end() || current.sequence < 0)
+		return false;
+	ClientStream& stream = it->second;
+
+	int baselineSequence = ChooseBaseline(stream);
+	const WorldSnapshot* baseline = baselineSequence >= 0 ? &stream.history[baselineSequence % SNAPSHOT_HISTORY] : nullptr;
+
+	// Never the baseline's slot- that's always less than a full history behind.
+	WorldSnapshot& snapshot = stream.history[current.sequence % SNAPSHOT_HISTORY];
+	snapshot.sequence = current.sequence;
+	snapshot.timeRemaining = current.timeRemaining;
+	snapshot.heldItem = heldItem;
+	snapshot.lastInput = lastInput;
+
+	// Anything out of the client's interest stays exactly as the baseline had it, which is what it'll decode to.
+	// A full snapshot has nothing to leave it as, so that gets everything.
+	snapshot.objects.resize(current.objects.size());
+	for (size_t i = 0; i < current.objects.size(); ++i)
+	{
+		bool wanted = !baseline || !relevant || (i < relevant->size() && (*relevant)[i]);
+		snapshot.objects[i] = wanted ? current.objects[i] : baseline->objects[i];
+	}
+
+	int bits = WriteSnapshot(snapshot, baseline, packet.data, MAX_SNAPSHOT_BYTES);
+	if (bits < 0)
+		bits = WriteTruncated(stream, client, baseline, relevant, snapshot, packet);
+	else
+		stream.truncating = false;
+
+	if (bits < 0)
+	{
+		// Not even the game state fits. The client can't have this one, so it can't be a baseline either.
+		snapshot.sequence = -1;
+		return false;
+	}
+
+	packet.sequence = current.sequence;
+	packet.baseline = baselineSequence;
+	packet.SetDataSize((bits + 7) / 8);
+	lastPacketBits = bits;
+	return true;
+}
+
+// Too much has changed to fit in one packet (e.g. a full snapshot of a busy world), so send what does fit, most important first-
+// everything in the client's interest, then the rest in order. Whatever's left out stays as the client already has it in the snapshot
+// kept for this client, so it's still different next time and goes out then instead. A client that needs a full snapshot gets one it can
+// acknowledge straight away, and is caught up over the next few.
+int SnapshotSender::WriteTruncated(ClientStream& stream, int client, const WorldSnapshot* baseline, const std::vector<bool>* relevant, WorldSnapshot& snapshot, SnapshotPacket& packet)
+{
+	int count = (int)snapshot.objects.size();
+	std::vector<QuantisedTransform> wanted(snapshot.objects);
+	for (int i = 0; i < count; ++i)
+		snapshot.objects[i] = baseline ? baseline->objects[i] : UNSENT;
+
+	// With nothing changed, every object costs its one bit and the rest is the game state.
+	int bits = WriteSnapshot(snapshot, baseline, packet.data, MAX_SNAPSHOT_BYTES);
+	if (bits < 0)
+		return -1;
+
+	int budget = MAX_SNAPSHOT_BYTES * 8;
+	int sent = 0;
+	int changed = 0;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			bool inInterest = !relevant || (i < (int)relevant->size() && (*relevant)[i]);
+			if (inInterest != (pass == 0) || wanted[i] == snapshot.objects[i])
+				continue;
+
+			changed++;
+			int cost = ObjectBits(wanted[i], snapshot.objects[i]) - 1;
+			if (bits + cost > budget)
+				continue;
+
+			snapshot.objects[i] = wanted[i];
+			bits += cost;
+			sent++;
+		}
+	}
+
+	// Only said once when a client's snapshots start being cut short, not every tick until it's caught up.
+	if (!stream.truncating)
+		std::cout << "Snapshot " << snapshot.sequence << " for client " << client << " is too big for one packet, sending " << sent << " of " << changed << " changed objects" << std::endl;
+	stream.truncating = true;
+	truncatedSnapshots++;
+
+	return WriteSnapshot(snapshot, baseline, packet.data, MAX_SNAPSHOT_BYTES);
+}
+
+/* RECEIVER */
+
+SnapshotReceiver::SnapshotReceiver(float sendRate, float interpolationDelay)
+{
+	snapshotInterval = 1.0f / sendRate;
+	this->interpolationDelay = interpolationDelay;
+	latestSequence = -1;
+	renderTime = 0.0f;
+}
+
+void SnapshotReceiver::AddObject(GameObject* object, bool ownedLocally)
+{
+	objects.emplace_back(object);
+	this->ownedLocally.emplace_back(ownedLocally);
+}
+
+void SnapshotReceiver::SetOwnedLocally(const GameObject* object)
+{
+	for (size_t i = 0; i < objects.size(); ++i)
+		ownedLocally[i] = objects[i] == object;
+}
+
+void SnapshotReceiver::Clear()
+{
+	objects.clear();
+	ownedLocally.clear();
+	for (WorldSnapshot& snapshot : history)
+		snapshot.sequence = -1;
+	latestSequence = -1;
+}
+
+bool SnapshotReceiver::Read(const SnapshotPacket& packet)
+{
+	// Anything older than what we've already got is no use.
+	if (packet.sequence <= latestSequence || packet.GetDataSize() > MAX_SNAPSHOT_BYTES)
+		return false;
+
+	const WorldSnapshot* baseline = nullptr;
+	if (packet.baseline >= 0)
+	{
+		baseline = &history[packet.baseline % SNAPSHOT_HISTORY];
+		if (baseline->sequence != packet.baseline)
+			return false;
+	}
+
+	WorldSnapshot& snapshot = history[packet.sequence % SNAPSHOT_HISTORY];
+	if (!ReadSnapshot(packet.data, packet.GetDataSize(), baseline, (int)objects.size(), snapshot))
+	{
+		snapshot.sequence = -1;
+		return false;
+	}
+
+	// Start the clock off the first snapshot.
+	if (latestSequence < 0)
+		renderTime = packet.sequence * snapshotInterval - interpolationDelay;
+
+	snapshot.sequence = packet.sequence;
+	latestSequence = packet.sequence;
+	return true;
+}
+
+void SnapshotReceiver::Update(float dt)
+{
+	if (latestSequence < 0)
+		return;
+
+	// Keep the clock the same distance behind the newest snapshot. Running it a little faster or slower soaks up jitter and the odd lost snapshot
+	// without anything visibly jumping- it's only reset outright if it's way off (e.g. after a stall).
+	float targetTime = latestSequence * snapshotInterval - interpolationDelay;
+	float drift = targetTime - renderTime - dt;
+	if (fabsf(drift) > MAX_CLOCK_DRIFT)
+		renderTime = targetTime;
+	else
+	{
+		float correction = drift * CLOCK_CORRECTION_RATE * dt;
+		float limit = MAX_CLOCK_SKEW * dt;
+		renderTime += dt + (correction > limit ? limit : (correction < -limit ? -limit : correction));
+	}
+
+	// Find the newest snapshot at or before the render time, and the one after it. Some may be missing along the way.
+	const WorldSnapshot* from = nullptr;
+	const WorldSnapshot* to = nullptr;
+	for (int sequence = latestSequence; sequence > latestSequence - SNAPSHOT_HISTORY && sequence >= 0; --sequence)
+	{
+		const WorldSnapshot& snapshot = history[sequence % SNAPSHOT_HISTORY];
+		if (snapshot.sequence != sequence)
+			continue;
+
+		from = &snapshot;
+		if (sequence * snapshotInterval <= renderTime)
+			break;
+		to = &snapshot;
+	}
+
+	if (!from)
+		return;
+	// Ran out of newer snapshots, so just hold the latest rather than guessing. Or the render time's before anything still kept, so hold the oldest.
+	if (!to || to == from)
+	{
+		Apply(*from, *from, 0.0f);
+		return;
+	}
+
+	float fromTime = from->sequence * snapshotInterval;
+	float toTime = to->sequence * snapshotInterval;
+	float alpha = (renderTime - fromTime) / (toTime - fromTime);
+	Apply(*from, *to, alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha));
+}
+
+void SnapshotReceiver::Apply(const WorldSnapshot& from, const WorldSnapshot& to, float alpha)
+{
+	for (size_t i = 0; i < objects.size(); ++i)
+	{
+		// Nothing to move it to if the server hasn't got round to sending it yet.
+		if (ownedLocally[i] || from.objects[i] == UNSENT || to.objects[i] == UNSENT)
+			continue;
+
+		Vector3 fromPosition = DequantisePosition(from.objects[i]);
+		Vector3 toPosition = DequantisePosition(to.objects[i]);
+
+		Transform& transform = objects[i]->GetTransform();
+		transform.SetWorldPosition(fromPosition + (toPosition - fromPosition) * alpha);
+		transform.SetLocalOrientation(Quaternion::Slerp(DequantiseOrientation(from.objects[i]), DequantiseOrientation(to.objects[i]), alpha));
+	}
+}
+
+bool SnapshotReceiver::GetLatestTransform(const GameObject* object, Vector3& position, Quaternion& orientation) const
+{
+	if (latestSequence < 0)
+		return false;
+
+	for (size_t i = 0; i < objects.size(); ++i)
+	{
+		if (objects[i] != object)
+			continue;
+
+		const QuantisedTransform& transform = GetLatest().objects[i];
+		if (transform == UNSENT)
+			return false;
+		position = DequantisePosition(transform);
+		orientation = DequantiseOrientation(transform);
+		return true;
+	}
+	return false;
+}
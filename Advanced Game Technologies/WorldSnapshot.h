@@ -0,0 +1,211 @@
+/*
+Author: Eleanor Gregory
+Date: Dec 2019
+
+Replicating the state of the whole world from the server to its clients in one packet per network tick.
+Every networked object's position and orientation is quantised (positions to 1/64 of a unit, orientations as their smallest three components),
+then written as a delta against the last snapshot that client has acknowledged- an object that hasn't moved costs a single bit,
+and small moves only a few more- and bit-packed along with the game state (timer, that client's held item).
+The world's only captured once per tick however many clients there are. Each client then gets its own stream, and objects the server
+decides aren't relevant to a client are left as that client last had them, so they cost one bit too.
+If a snapshot won't fit in the packet (a full one of a busy world, say), the objects relevant to the client go first and whatever's
+left over is sent over the next few.
+Both ends have to add the same objects in the same order, which they do by building them from the same level file.
+Clients don't snap objects to each snapshot as it arrives- they're kept in a buffer and everything the client doesn't control is drawn
+a little in the past, blended between the two snapshots either side of that time.
+
+/ᐠ .ᆺ. ᐟ\ﾉ
+
+*/
+
+#pragma once
+#include "../CSC8503Common/NetworkBase.h"
+#include "PacketDispatcher.h"
+#include "../../Common/Vector3.h"
+#include "../../Common/Quaternion.h"
+#include <map>
+#include <vector>
+
+using namespace NCL::Maths;
+
+namespace NCL {
+	namespace CSC8503 {
+		class GameObject;
+
+		// Comfortably inside a single UDP datagram.
+		const int MAX_SNAPSHOT_BYTES = 1200;
+		// How many old snapshots each end keeps around to be deltas against. Acks older than this just get a full snapshot.
+		const int SNAPSHOT_HISTORY = 32;
+
+		struct QuantisedTransform
+		{
+			int x;
+			int y;
+			int z;
+			// Index of the dropped component in the top two bits, then the other three at 10 bits each.
+			unsigned int orientation;
+
+			bool operator==(const QuantisedTransform& other) const
+			{
+				return x == other.x && y == other.y && z == other.z && orientation == other.orientation;
+			}
+			bool operator!=(const QuantisedTransform& other) const { return !(*this == other); }
+		};
+
+		QuantisedTransform QuantiseTransform(const Vector3& position, const Quaternion& orientation);
+		Vector3 DequantisePosition(const QuantisedTransform& transform);
+		Quaternion DequantiseOrientation(const QuantisedTransform& transform);
+
+		struct WorldSnapshot
+		{
+			int sequence = -1;
+			int timeRemaining = 0;
+			// -1 for nothing held.
+			int heldItem = -1;
+			// The last of the client's inputs the server had applied, for it to reconcile its prediction against. -1 before any have arrived.
+			int lastInput = -1;
+			std::vector<QuantisedTransform> objects;
+		};
+
+		struct SnapshotPacket : public GamePacket
+		{
+			int sequence;
+			// Which snapshot the data is a delta against, or -1 if it's a full snapshot.
+			int baseline;
+			char data[MAX_SNAPSHOT_BYTES];
+
+			SnapshotPacket()
+			{
+				type = Delta_State;
+				sequence = 0;
+				baseline = -1;
+				SetDataSize(0);
+			}
+
+			// Only the bytes actually written go over the wire.
+			void SetDataSize(int bytes) { size = (short)(sizeof(int) * 2 + bytes); }
+			int GetDataSize() const { return size - (int)sizeof(int) * 2; }
+		};
+
+		struct SnapshotAckPacket : public GamePacket
+		{
+			int sequence;
+
+			SnapshotAckPacket(int sequence)
+			{
+				type = Received_State;
+				size = sizeof(int);
+				this->sequence = sequence;
+			}
+		};
+
+		// Snapshots are only as long as the data in them.
+		template <>
+		struct PacketTraits<SnapshotPacket>
+		{
+			static const int Type = Delta_State;
+			static const int MinSize = sizeof(int) * 2;
+		};
+
+		template <>
+		struct PacketTraits<SnapshotAckPacket> : public FixedSizePacketTraits<SnapshotAckPacket, Received_State> {};
+
+		// Server side- captures the world at the send rate, then builds each client's snapshot against whatever that client has acknowledged.
+		class SnapshotSender
+		{
+		public:
+			SnapshotSender(float sendRate = 20.0f);
+			~SnapshotSender() {}
+
+			void AddObject(GameObject* object) { objects.emplace_back(object); }
+			void Clear();
+
+			void SetSendRate(float rate) { sendInterval = 1.0f / rate; }
+			void SetTimeRemaining(int timeRemaining) { this->timeRemaining = timeRemaining; }
+
+			// True when snapshots are due, with the world captured ready for each client's to be written.
+			bool Update(float dt);
+			// One client's snapshot of the last capture. Objects not in relevant (by index) are left as the client already has them- no relevant means everything.
+			bool Write(int client, int heldItem, int lastInput, const std::vector<bool>* relevant, SnapshotPacket& packet);
+
+			// Clients start out on full snapshots until they've acknowledged one.
+			void AddClient(int client);
+			void Acknowledge(int client, int sequence);
+			void RemoveClient(int client) { clients.erase(client); }
+
+			int GetLastPacketBits() const { return lastPacketBits; }
+			// How many snapshots have had to leave changes out to fit in a packet.
+			int GetTruncatedSnapshots() const { return truncatedSnapshots; }
+
+		protected:
+			// What one client's been sent, for later snapshots to be deltas against.
+			struct ClientStream
+			{
+				int acknowledged = -1;
+				// Whether the last snapshot had to be cut short.
+				bool truncating = false;
+				WorldSnapshot history[SNAPSHOT_HISTORY];
+			};
+
+			int ChooseBaseline(const ClientStream& stream) const;
+			int WriteTruncated(ClientStream& stream, int client, const WorldSnapshot* baseline, const std::vector<bool>* relevant, WorldSnapshot& snapshot, SnapshotPacket& packet);
+			void Capture(WorldSnapshot& snapshot) const;
+
+			std::vector<GameObject*> objects;
+			WorldSnapshot current;
+			int nextSequence;
+
+			std::map<int, ClientStream> clients;
+
+			float sendInterval;
+			float sendTimer;
+
+			int timeRemaining;
+			int lastPacketBits;
+			int truncatedSnapshots;
+		};
+
+		// Client side- decodes snapshots and moves the objects it doesn't control itself to match, smoothly.
+		class SnapshotReceiver
+		{
+		public:
+			// Needs the server's send rate to know how far apart snapshots are. By default objects are drawn two snapshots behind,
+			// so there's nearly always a newer one to blend towards even if one goes missing.
+			SnapshotReceiver(float sendRate = 20.0f, float interpolationDelay = 0.1f);
+			~SnapshotReceiver() {}
+
+			// Objects owned locally (the client's own goose) are still decoded, just never moved.
+			void AddObject(GameObject* object, bool ownedLocally = false);
+			// Hands control of one object over to this end- only one at a time, so any other goes back to following the server.
+			void SetOwnedLocally(const GameObject* object);
+			void Clear();
+
+			// False if the packet's stale or its baseline has been lost, in which case it shouldn't be acknowledged.
+			bool Read(const SnapshotPacket& packet);
+			// Every frame- moves the remote objects to where they were interpolationDelay ago.
+			void Update(float dt);
+
+			const WorldSnapshot& GetLatest() const { return history[latestSequence % SNAPSHOT_HISTORY]; }
+			int GetLatestSequence() const { return latestSequence; }
+			// Where the latest snapshot had a particular object.
+			bool GetLatestTransform(const GameObject* object, Vector3& position, Quaternion& orientation) const;
+
+		protected:
+			void Apply(const WorldSnapshot& from, const WorldSnapshot& to, float alpha);
+
+			std::vector<GameObject*> objects;
+			std::vector<bool> ownedLocally;
+			WorldSnapshot history[SNAPSHOT_HISTORY];
+			int latestSequence;
+
+			float snapshotInterval;
+			float interpolationDelay;
+			// In the server's time, worked out from snapshot numbers- it sends them at a fixed rate.
+			float renderTime;
+		};
+
+		// The encoding itself, shared by both ends. No baseline for a full snapshot.
+		int WriteSnapshot(const WorldSnapshot& snapshot, const WorldSnapshot* baseline, char* buffer, int capacityBytes);
+		bool ReadSnapshot(const char* buffer, int sizeBytes, const WorldSnapshot* baseline, int objectCount, WorldSnapshot& outSnapshot);
+	}
+}